@@ -2,30 +2,60 @@
 QT       += widgets
 QT       += serialport
 QT       += network
+QT       += concurrent
 
 TARGET = GREFwTool
 TEMPLATE = app
+CONFIG += c++14
 VERSION = 0.2.0.3
 
 DEFINES += APP_VERSION=\\\"$$VERSION\\\"
 DEFINES += QT_NO_SSL
 
+# liblzma decodes the 7z firmware archives
+LIBS += -llzma
+
 SOURCES += \
     source/main.cpp \
     source/mainwindow.cpp \
     source/settingsdialog.cpp \
     source/greparser.cpp \
+    source/greringbuffer.cpp \
+    source/grecapture.cpp \
+    source/grelatency.cpp \
+    source/grefilewriter.cpp \
+    source/greccdump.cpp \
+    source/grelcdmirror.cpp \
+    source/gretrace.cpp \
     source/grefirmware.cpp \
+    source/grefirmwarecache.cpp \
+    source/grefirmwarecatalogue.cpp \
+    source/gre7zarchive.cpp \
+    source/gretranscodecheck.cpp \
     source/webdownloader.cpp \
-    source/display.cpp
+    source/display.cpp \
+    source/lcdmirror.cpp
 
 HEADERS += \
     include/mainwindow.h \
     include/settingsdialog.h \
     include/greparser.h \
+    include/greringbuffer.h \
+    include/greprotocol.h \
+    include/grecapture.h \
+    include/grelatency.h \
+    include/grefilewriter.h \
+    include/greccdump.h \
+    include/grelcdmirror.h \
+    include/gretrace.h \
     include/grefirmware.h \
+    include/grefirmwarecache.h \
+    include/grefirmwarecatalogue.h \
+    include/gre7zarchive.h \
+    include/gretranscodecheck.h \
     include/webdownloader.h \
-    include/display.h
+    include/display.h \
+    include/lcdmirror.h
 
 FORMS += \
     ui/mainwindow.ui \
@@ -0,0 +1,45 @@
+
+QT       -= gui
+QT       += core concurrent
+
+TARGET = GREFwToolBenchmark
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+PROJECT_DIR = $$clean_path($$PWD/../)
+INCLUDEPATH += $$PROJECT_DIR
+DEFINES += FIRMWARE_DIR=\\\"$$PROJECT_DIR/firmware\\\"
+LIBS += -llzma
+
+SOURCES += \
+    benchmark.cpp \
+    $$PROJECT_DIR/source/greparser.cpp \
+    $$PROJECT_DIR/source/greringbuffer.cpp \
+    $$PROJECT_DIR/source/grecapture.cpp \
+    $$PROJECT_DIR/source/grelatency.cpp \
+    $$PROJECT_DIR/source/grefilewriter.cpp \
+    $$PROJECT_DIR/source/greccdump.cpp \
+    $$PROJECT_DIR/source/grelcdmirror.cpp \
+    $$PROJECT_DIR/source/gretrace.cpp \
+    $$PROJECT_DIR/source/grefirmware.cpp \
+    $$PROJECT_DIR/source/grefirmwarecache.cpp \
+    $$PROJECT_DIR/source/grefirmwarecatalogue.cpp \
+    $$PROJECT_DIR/source/gre7zarchive.cpp \
+    $$PROJECT_DIR/source/gretranscodecheck.cpp
+
+HEADERS += \
+    $$PROJECT_DIR/include/greparser.h \
+    $$PROJECT_DIR/include/greringbuffer.h \
+    $$PROJECT_DIR/include/greprotocol.h \
+    $$PROJECT_DIR/include/grecapture.h \
+    $$PROJECT_DIR/include/grelatency.h \
+    $$PROJECT_DIR/include/grefilewriter.h \
+    $$PROJECT_DIR/include/greccdump.h \
+    $$PROJECT_DIR/include/grelcdmirror.h \
+    $$PROJECT_DIR/include/gretrace.h \
+    $$PROJECT_DIR/include/grefirmware.h \
+    $$PROJECT_DIR/include/grefirmwarecache.h \
+    $$PROJECT_DIR/include/grefirmwarecatalogue.h \
+    $$PROJECT_DIR/include/gre7zarchive.h \
+    $$PROJECT_DIR/include/gretranscodecheck.h
@@ -0,0 +1,1067 @@
+/* benchmark.cpp - GREParser receive and framing benchmarks
+        Every stream is generated from a fixed seed and the report layout is fixed,
+        so the output of two releases can be compared with diff.
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/greparser.h"
+#include "include/greringbuffer.h"
+#include "include/greprotocol.h"
+#include "include/grecapture.h"
+#include "include/greccdump.h"
+#include "include/grelcdmirror.h"
+#include "include/gretrace.h"
+#include "include/grefirmware.h"
+#include "include/grefirmwarecache.h"
+#include "include/grefirmwarecatalogue.h"
+#include "include/gre7zarchive.h"
+#include "include/gretranscodecheck.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int streamSize = 8 * 1024 * 1024;  // bytes per receive stream
+static const int chunkSize = 4096;              // same as the MainWindow receive buffer
+static const int repeatCount = 5;               // best of repeatCount runs is reported
+static const int commandCount = 200000;         // commands framed per command benchmark
+static const int firmwareImageSize = 0x200000;  // bytes in the firmware load benchmark image
+
+/* Heap allocation counter
+		With glibc the C allocation functions are replaced by counting wrappers, which also
+		catches QByteArray and QString storage that does not go through operator new.
+*/
+static std::atomic<qint64> allocationCount(0);
+
+#if defined(__GLIBC__)
+#define BENCHMARK_COUNT_ALLOCATIONS
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size)
+{
+    allocationCount++;
+    return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return __libc_calloc(count, size);
+}
+void *realloc(void *p, size_t size)
+{
+    allocationCount++;
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+/* Random - small fixed seed generator so every run sees the same streams
+*/
+class Random
+{
+public:
+    explicit Random(quint32 seed) : state(seed) {}
+    quint32 next() { state = state * 1103515245u + 12345u; return state >> 8; }
+private:
+    quint32 state;
+};
+
+/* Result - outcome of one receive benchmark
+*/
+struct Result
+{
+    qint64 bytes;
+    qint64 events;      // frames, control byte indications and CCDump lines
+    qint64 nsecs;
+};
+
+/* appendFrame - append a response packet: STX, data, ETX and checksum
+*/
+static void appendFrame(QByteArray &stream, const QByteArray &data)
+{
+    unsigned char checksum = GREProtocol::ETX;
+    for(QByteArray::const_iterator it = data.cbegin(); it != data.cend(); it++)
+        checksum += *it;
+    stream.append(static_cast<char>(GREProtocol::STX));
+    stream.append(data);
+    stream.append(static_cast<char>(GREProtocol::ETX));
+    stream.append(static_cast<char>(checksum));
+}
+/* appendResponse - append a known length response with random data
+*/
+static void appendResponse(QByteArray &stream, char command, Random &random)
+{
+    QByteArray data(GREProtocol::responseLength(command), '\0');
+    data[0] = command;
+    for(int i = 1; i < data.size(); i++)
+        data[i] = static_cast<char>(random.next());
+    appendFrame(stream, data);
+}
+/* makeBootloaderFlood - CPU update mode indication followed by ENQ/ACK traffic of a firmware update
+*/
+static QByteArray makeBootloaderFlood(int size)
+{
+    QByteArray stream("CCC");
+    stream.reserve(size);
+    while(stream.size() < size)
+    {
+        stream.append(static_cast<char>(GREProtocol::ENQ));
+        for(int i = 0; i < 63; i++)
+            stream.append(static_cast<char>(GREProtocol::ACK));
+        stream.append(static_cast<char>(GREProtocol::DLE));
+    }
+    return stream;
+}
+/* makeResponseMix - application mode responses, mostly status and LCD polling with some version requests
+*/
+static QByteArray makeResponseMix(int size, quint32 seed)
+{
+    static const char commands[] = { 'A', 'A', 'A', 'L', 'L', 'L', 'V', 'P' };
+    Random random(seed);
+    QByteArray stream;
+    stream.reserve(size + 128);
+    while(stream.size() < size)
+        appendResponse(stream, commands[random.next() % sizeof(commands)], random);
+    return stream;
+}
+/* makeDamagedMix - response mix with one random byte dropped or changed per interval bytes, as on a marginal link
+*/
+static QByteArray makeDamagedMix(int size, int interval)
+{
+    QByteArray stream = makeResponseMix(size, 6);
+    Random random(7);
+    for(int i = interval; i < stream.size(); i += interval)
+    {
+        int at = i - static_cast<int>(random.next() % interval);
+        if(random.next() & 1)
+            stream.remove(at, 1);
+        else
+            stream[at] = static_cast<char>(random.next());
+    }
+    return stream;
+}
+/* makeCCDump - control channel dump text lines
+*/
+static QByteArray makeCCDump(int size)
+{
+    Random random(3);
+    QByteArray stream;
+    stream.reserve(size + 128);
+    while(stream.size() < size)
+    {
+        quint32 value = random.next();
+        stream.append(QString("%1: TGID %2 RID %3 SITE %4 CH %5\r\n")
+                      .arg(value, 8, 10, QLatin1Char('0')).arg(value % 65535).arg(value % 9999999)
+                      .arg(value % 255).arg(value % 1024).toLatin1());
+    }
+    return stream;
+}
+/* makeGarbage - random bytes, as seen on a noisy link or with a wrong baud rate
+*/
+static QByteArray makeGarbage(int size)
+{
+    Random random(4);
+    QByteArray stream(size, '\0');
+    for(int i = 0; i < size; i++)
+        stream[i] = static_cast<char>(random.next());
+    return stream;
+}
+/* connectCounters - count every event the parser reports
+*/
+static void connectCounters(GREParser &parser, qint64 &events)
+{
+    QObject::connect(&parser, &GREParser::updateFrame, [&events](const QByteArray &) { events++; });
+    QObject::connect(&parser, &GREParser::updateEnq, [&events]() { events++; });
+    QObject::connect(&parser, &GREParser::updateAck, [&events]() { events++; });
+    QObject::connect(&parser, &GREParser::updateDLE, [&events]() { events++; });
+    QObject::connect(&parser, &GREParser::updateCCDump, [&events](const QByteArray &) { events++; });
+}
+/* feedStream - pass a stream through a ring buffer into the parser, as MainWindow::readData does
+*/
+static void feedStream(GREParser &parser, const QByteArray &stream)
+{
+    GRERingBuffer buffer(chunkSize);
+    const char *data = stream.constData();
+    int remaining = stream.size();
+    int length;
+    char *span;
+    while(remaining > 0)
+    {
+        span = buffer.writeSpan(length);
+        if(length > remaining)
+            length = remaining;
+        memcpy(span, data, length);
+        buffer.commit(length);
+        parser.receiveData(buffer);
+        data += length;
+        remaining -= length;
+    }
+}
+/* runStream - best of repeatCount parses of a stream by a fresh parser
+*/
+static Result runStream(const QByteArray &stream)
+{
+    Result best = { stream.size(), 0, 0 };
+    QElapsedTimer timer;
+    for(int i = 0; i < repeatCount; i++)
+    {
+        GREParser parser;
+        qint64 events = 0;
+        connectCounters(parser, events);
+        timer.start();
+        feedStream(parser, stream);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best.nsecs == 0) || (nsecs < best.nsecs))
+        {
+            best.nsecs = nsecs;
+            best.events = events;
+        }
+    }
+    return best;
+}
+/* runCCDumpSink - best of repeatCount CCDump streams decoded and written to a file
+		The time includes writing out everything still pending when the stream ends
+*/
+static Result runCCDumpSink(const QByteArray &stream)
+{
+    Result best = { stream.size(), 0, 0 };
+    QString fileName = QDir::temp().filePath("GREFwToolBenchmark.tsv");
+    QElapsedTimer timer;
+    for(int i = 0; i < repeatCount; i++)
+    {
+        GREParser parser;
+        GRECCDump ccDump;
+        QObject::connect(&parser, &GREParser::updateCCDump, &ccDump, &GRECCDump::processLine);
+        if(!ccDump.start(fileName))
+            break;
+        timer.start();
+        feedStream(parser, stream);
+        ccDump.stop();
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best.nsecs == 0) || (nsecs < best.nsecs))
+        {
+            best.nsecs = nsecs;
+            best.events = ccDump.getLineCount();
+        }
+    }
+    QFile::remove(fileName);
+    return best;
+}
+/* runThreads - parse a separate interleaved response stream with one parser per thread
+		Each thread must count the same events as a parser on its own did for the same stream,
+		ok is cleared if one does not, so parsers sharing state between instances fail.
+*/
+static Result runThreads(int threads, const QVector<QByteArray> &streams, const QVector<qint64> &expected, bool &ok)
+{
+    Result result = { 0, 0, 0 };
+    std::vector<std::thread> workers;
+    QVector<qint64> events(threads, 0);
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < threads; i++)
+    {
+        qint64 *count = &events[i];
+        const QByteArray *stream = &streams.at(i);
+        workers.emplace_back([count, stream]() {
+            GREParser parser;
+            connectCounters(parser, *count);
+            feedStream(parser, *stream);
+        });
+    }
+    for(std::thread &worker : workers)
+        worker.join();
+    result.nsecs = timer.nsecsElapsed();
+    for(int i = 0; i < threads; i++)
+    {
+        result.bytes += streams.at(i).size();
+        result.events += events.at(i);
+        if(events.at(i) != expected.at(i))
+            ok = false;
+    }
+    return result;
+}
+/* runCapture - best of repeatCount full speed replays of a capture file through a fresh parser
+*/
+static Result runCapture(const QString &fileName, bool &ok)
+{
+    Result best = { 0, 0, 0 };
+    QElapsedTimer timer;
+    ok = true;
+    for(int i = 0; i < repeatCount && ok; i++)
+    {
+        GREParser parser;
+        GRECaptureReplay replay(&parser);
+        qint64 events = 0;
+        qint64 bytes = 0;
+        connectCounters(parser, events);
+        QObject::connect(&replay, &GRECaptureReplay::replayRx, [&bytes](const QByteArray &data) { bytes += data.size(); });
+        ok = replay.open(fileName);
+        timer.start();
+        replay.start(false);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best.nsecs == 0) || (nsecs < best.nsecs))
+        {
+            best.bytes = bytes;
+            best.nsecs = nsecs;
+            best.events = events;
+        }
+    }
+    return best;
+}
+/* printResult - print one receive benchmark line
+*/
+static void printResult(QTextStream &out, const QString &name, const Result &result)
+{
+    double seconds = result.nsecs / 1e9;
+    out << QString("%1 %2 MB/s %3 frames/s %4 frames\n")
+           .arg(name, -32)
+           .arg(result.bytes / seconds / 1e6, 10, 'f', 1)
+           .arg(result.events / seconds, 12, 'f', 0)
+           .arg(result.events, 9);
+    out.flush();
+}
+/* benchmarkCommand - time the framing of one command and print the cost per command
+		The heap allocations made while framing are counted to check the zero allocation path
+*/
+template<typename Send>
+static void benchmarkCommand(QTextStream &out, const QString &name, Send send)
+{
+    GREParser parser;
+    qint64 bytes = 0;
+    qint64 best = 0;
+    qint64 allocations;
+    QElapsedTimer timer;
+    QObject::connect(&parser, &GREParser::sendData, [&bytes](const QByteArray &data) { bytes += data.size(); });
+    send(parser); // warm up
+    bytes = 0;
+    allocations = allocationCount;
+    for(int r = 0; r < repeatCount; r++)
+    {
+        timer.start();
+        for(int i = 0; i < commandCount; i++)
+            send(parser);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    allocations = allocationCount - allocations;
+    out << QString("%1 %2 ns/command %3 bytes/command")
+           .arg(name, -32)
+           .arg(static_cast<double>(best) / commandCount, 10, 'f', 1)
+           .arg(bytes / (static_cast<qint64>(commandCount) * repeatCount), 6);
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    out << QString(" %1 allocations/command").arg(static_cast<double>(allocations) / (static_cast<qint64>(commandCount) * repeatCount), 6, 'f', 2);
+#else
+    Q_UNUSED(allocations);
+#endif
+    out << "\n";
+    out.flush();
+}
+/* PacketLoop - the firmware update ACK to next packet loop of MainWindow without the serial port
+*/
+class PacketLoop : public QObject
+{
+    Q_OBJECT
+public:
+    PacketLoop(GREParser *parser, const QByteArray &packet) : parser(parser), packet(packet), bytes(0) {}
+    qint64 getBytes() const { return bytes; }
+public slots:
+    void writeData(const QByteArray &data) { bytes += data.size(); }
+    void processAck() { parser->sendPacket(packet); }
+private:
+    GREParser *parser;
+    QByteArray packet;
+    qint64 bytes;
+};
+
+/* benchmarkDispatch - time one ACK received to next packet sent cycle through the signal connections
+*/
+static void benchmarkDispatch(QTextStream &out, const QString &name, bool stringConnections)
+{
+    GREParser parser;
+    PacketLoop loop(&parser, QByteArray(100, 'A'));
+    const char ackByte[1] = { GREProtocol::ACK };
+    const QByteArray ack = QByteArray::fromRawData(ackByte, 1);
+    qint64 best = 0;
+    qint64 allocations;
+    qint64 bytes;
+    QElapsedTimer timer;
+    if(stringConnections)
+    {
+        QObject::connect(&parser, SIGNAL(sendData(QByteArray)), &loop, SLOT(writeData(QByteArray)));
+        QObject::connect(&parser, SIGNAL(updateAck(void)), &loop, SLOT(processAck(void)));
+    }
+    else
+    {
+        QObject::connect(&parser, &GREParser::sendData, &loop, &PacketLoop::writeData, Qt::DirectConnection);
+        QObject::connect(&parser, &GREParser::updateAck, &loop, &PacketLoop::processAck, Qt::DirectConnection);
+    }
+    parser.receiveData(ack); // warm up
+    bytes = loop.getBytes();
+    allocations = allocationCount;
+    for(int r = 0; r < repeatCount; r++)
+    {
+        timer.start();
+        for(int i = 0; i < commandCount; i++)
+            parser.receiveData(ack);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    allocations = allocationCount - allocations;
+    bytes = loop.getBytes() - bytes;
+    out << QString("%1 %2 ns/packet %3 bytes/packet")
+           .arg(name, -32)
+           .arg(static_cast<double>(best) / commandCount, 10, 'f', 1)
+           .arg(bytes / (static_cast<qint64>(commandCount) * repeatCount), 6);
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    out << QString(" %1 allocations/packet").arg(static_cast<double>(allocations) / (static_cast<qint64>(commandCount) * repeatCount), 6, 'f', 2);
+#else
+    Q_UNUSED(allocations);
+#endif
+    out << "\n";
+    out.flush();
+}
+/* benchmarkLCDDiff - time the comparison of two LCD frames differing in changedBytes places
+*/
+static void benchmarkLCDDiff(QTextStream &out, const QString &name, int changedBytes)
+{
+    GREParser::GetLCDVal previous;
+    GREParser::GetLCDVal frame;
+    GRELCDMirror::Changes changes;
+    qint64 best = 0;
+    qint64 ranges = 0;
+    QElapsedTimer timer;
+    memset(&previous, ' ', sizeof(previous));
+    memset(&frame, ' ', sizeof(frame));
+    for(int i = 0; i < changedBytes; i++)
+        frame.lcd[(i * 37) % GREParser::LCD_SIZE] = 'X';
+    for(int r = 0; r < repeatCount; r++)
+    {
+        ranges = 0;
+        timer.start();
+        for(int i = 0; i < commandCount; i++)
+        {
+            frame.icons[0] = static_cast<quint8>(i & 1);
+            GRELCDMirror::diffFrames(previous, frame, changes);
+            ranges += changes.rangeCount;
+        }
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    out << QString("%1 %2 ns/frame %3 ranges/frame\n")
+           .arg(name, -32)
+           .arg(static_cast<double>(best) / commandCount, 10, 'f', 1)
+           .arg(static_cast<double>(ranges) / commandCount, 6, 'f', 1);
+    out.flush();
+}
+/* benchmarkTrace - time recording a 100 byte packet into the protocol trace and formatting it later
+*/
+static void benchmarkTrace(QTextStream &out, const QString &name)
+{
+    GRETrace trace;
+    QByteArray packet(100, 'A');
+    qint64 best = 0;
+    qint64 formatBest = 0;
+    QElapsedTimer timer;
+    for(int r = 0; r < repeatCount; r++)
+    {
+        trace.clear();
+        timer.start();
+        for(int i = 0; i < commandCount; i++)
+            trace.record(GRETrace::TRACE_TX_BYTES, packet.constData(), packet.size());
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+        int count = trace.getEntryCount();
+        qint64 length = 0;
+        timer.start();
+        for(int i = 0; i < count; i++)
+            length += trace.formatEntry(i).size();
+        nsecs = (count == 0) ? 0 : (timer.nsecsElapsed() / count);
+        if((formatBest == 0) || (nsecs < formatBest))
+            formatBest = nsecs;
+        Q_UNUSED(length);
+    }
+    out << QString("%1 %2 ns/packet").arg(name, -32).arg(static_cast<double>(best) / commandCount, 10, 'f', 1);
+    if(formatBest != 0)
+        out << QString(" %1 ns/formatted entry").arg(formatBest, 8);
+    out << "\n";
+    out.flush();
+}
+/* benchmarkFirmwareLoad - time loading a firmware image file, optionally transcoding it
+		The heap allocations show whether the image was copied
+*/
+static void benchmarkFirmwareLoad(QTextStream &out, const QString &name, const QString &fileName, quint8 newPlatform)
+{
+    GREFirmware firmware;
+    qint64 best = 0;
+    qint64 allocations = 0;
+    bool ok = true;
+    QElapsedTimer timer;
+    for(int r = 0; r < repeatCount && ok; r++)
+    {
+        qint64 count = allocationCount;
+        timer.start();
+        ok = firmware.load(fileName);
+        if(ok && (newPlatform != 0))
+            ok = firmware.transcode(newPlatform);
+        qint64 nsecs = timer.nsecsElapsed();
+        allocations = allocationCount - count;
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    if(!ok)
+    {
+        out << QString("%1 failed\n").arg(name, -32);
+        return;
+    }
+    out << QString("%1 %2 ms %3 mapped").arg(name, -32).arg(best / 1e6, 10, 'f', 3).arg(firmware.isMapped() ? "yes" : "no");
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    out << QString(" %1 allocations").arg(allocations, 6);
+#else
+    Q_UNUSED(allocations);
+#endif
+    out << "\n";
+    out.flush();
+}
+/* benchmarkPreflight - time the checks made before an update, with a streaming transcode to newPlatform
+		if it is not 0 and with the pre-encoded packet table if framed. Returns the preflight result.
+*/
+static bool benchmarkPreflight(QTextStream &out, const QString &name, const QString &fileName, quint8 newPlatform, bool framed)
+{
+    GREFirmware firmware;
+    GREFirmware::Preflight check;
+    qint64 best = 0;
+    bool ok = firmware.load(fileName) && ((newPlatform == 0) || firmware.beginTranscode(newPlatform)) && (!framed || firmware.encodePackets());
+    QElapsedTimer timer;
+    if(!ok)
+    {
+        out << QString("%1 load or transcode refused\n").arg(name, -32);
+        return false;
+    }
+    for(int r = 0; r < repeatCount; r++)
+    {
+        timer.start();
+        ok = firmware.preflight(check);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    out << QString("%1 %2 ms version %3 fingerprint %4 %5\n")
+           .arg(name, -32)
+           .arg(best / 1e6, 10, 'f', 3)
+           .arg(GREFirmware::formatVersion(check.version))
+           .arg(QString::number(check.fingerprint, 16).toUpper().rightJustified(16, QLatin1Char('0')))
+           .arg(ok ? QString("ok") : QString("error %1").arg(check.error));
+    out.flush();
+    return ok;
+}
+/* benchmarkTranscode - time the XOR transcode of a firmware image, with the old byte loop or the kernel
+*/
+static void benchmarkTranscode(QTextStream &out, const QString &name, bool byteLoop)
+{
+    QByteArray image = makeGarbage(firmwareImageSize);
+    quint8 key[256];
+    qint64 best = 0;
+    QElapsedTimer timer;
+    // the E4 to E6 key, recovered by transcoding zeros
+    memset(key, 0, sizeof(key));
+    GREFirmware::transcodeData(0xE4, 0xE6, reinterpret_cast<char *>(key), sizeof(key));
+    for(int r = 0; r < repeatCount; r++)
+    {
+        timer.start();
+        if(byteLoop)
+        {
+            int i = 0;
+            for(QByteArray::iterator it = image.begin(); it != image.end(); it++)
+            {
+                *it = *it ^ *(key + i);
+                i = (i + 1) % 256;
+            }
+        }
+        else
+            GREFirmware::transcodeData(0xE4, 0xE6, image.data(), image.size());
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    out << QString("%1 %2 MB/s\n").arg(name, -32).arg(image.size() / (best / 1e9) / 1e6, 10, 'f', 1);
+    out.flush();
+}
+/* benchmarkPackets - time getting and sending every packet of a firmware image
+		Framed sends the views of the pre-encoded packet table, otherwise each packet is hex
+		encoded and framed when it is sent. The time to build the table is printed separately.
+*/
+static void benchmarkPackets(QTextStream &out, const QString &name, bool framed)
+{
+    GREFirmware firmware;
+    GREParser parser;
+    QByteArray buffer(GREFirmware::HEADER_SIZE, '\0');
+    qint64 bytes = 0;
+    qint64 packets = 0;
+    qint64 best = 0;
+    qint64 encodeBest = 0;
+    qint64 allocations;
+    QElapsedTimer timer;
+    buffer[0] = '\xE6';
+    buffer[1] = static_cast<char>(firmwareImageSize >> 16);
+    buffer[2] = static_cast<char>(firmwareImageSize >> 8);
+    buffer[3] = static_cast<char>(firmwareImageSize);
+    buffer.append(makeGarbage(firmwareImageSize));
+    firmware.loadBuffer(buffer);
+    QObject::connect(&parser, &GREParser::sendData, [&bytes](const QByteArray &data) { bytes += data.size(); });
+    allocations = allocationCount;
+    for(int r = 0; r < repeatCount; r++)
+    {
+        QByteArray packet;
+        packets = 0;
+        if(framed)
+        {
+            timer.start();
+            firmware.encodePackets();
+            qint64 nsecs = timer.nsecsElapsed();
+            if((encodeBest == 0) || (nsecs < encodeBest))
+                encodeBest = nsecs;
+        }
+        timer.start();
+        packet = framed ? firmware.getFirstFrame() : firmware.getFirstPacket();
+        while(!packet.isEmpty())
+        {
+            if(framed)
+                parser.sendFrame(packet);
+            else
+                parser.sendPacket(packet);
+            packets++;
+            packet = framed ? firmware.getNextFrame() : firmware.getNextPacket();
+        }
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+    }
+    allocations = allocationCount - allocations;
+    out << QString("%1 %2 ns/packet %3 bytes/packet")
+           .arg(name, -32)
+           .arg(static_cast<double>(best) / packets, 10, 'f', 1)
+           .arg(bytes / (packets * repeatCount), 6);
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    out << QString(" %1 allocations/packet").arg(static_cast<double>(allocations) / (packets * repeatCount), 6, 'f', 2);
+#else
+    Q_UNUSED(allocations);
+#endif
+    if(framed)
+        out << QString(" %1 ms to encode").arg(encodeBest / 1e6, 8, 'f', 3);
+    out << "\n";
+    out.flush();
+}
+/* verifyStreamTranscode - compare the streaming transcode with the batch transcode
+		Every supported platform pair is checked with image versions before, at and after
+		each patch table entry. Both must accept or reject the image, and produce the same
+		packets and the same pre-encoded frames. Prints the time to the first data packet.
+*/
+static bool verifyStreamTranscode(QTextStream &out)
+{
+    static const quint8 versions[] = { 50, 56, 57, 58, 64, 65, 66, 67, 68, 69, 70 };
+    QByteArray buffer(GREFirmware::HEADER_SIZE, '\0');
+    qint64 batchBest = 0;
+    qint64 streamBest = 0;
+    int checked = 0;
+    bool ok = true;
+    QElapsedTimer timer;
+    buffer[1] = static_cast<char>(firmwareImageSize >> 16);
+    buffer[2] = static_cast<char>(firmwareImageSize >> 8);
+    buffer[3] = static_cast<char>(firmwareImageSize);
+    buffer.append(makeGarbage(firmwareImageSize));
+    for(int pair = 0; pair < GREFirmware::getTranscodeCount(); pair++)
+    {
+        quint8 oldPlatform;
+        quint8 newPlatform;
+        GREFirmware::getTranscodePair(pair, oldPlatform, newPlatform);
+        for(quint8 version : versions)
+        {
+            GREFirmware batch;
+            GREFirmware stream;
+            buffer[0] = static_cast<char>(oldPlatform);
+            buffer[GREFirmware::HEADER_SIZE + 4] = static_cast<char>(version ^ 0x4e);  // version byte of the WS-1080 patch table
+            batch.loadBuffer(buffer);
+            stream.loadBuffer(buffer);
+            timer.start();
+            bool batchOk = batch.transcode(newPlatform);
+            if(batchOk)
+            {
+                batch.getFirstPacket();
+                batch.getNextPacket();
+            }
+            qint64 nsecs = timer.nsecsElapsed();
+            if(batchOk && ((batchBest == 0) || (nsecs < batchBest)))
+                batchBest = nsecs;
+            timer.start();
+            bool streamOk = stream.beginTranscode(newPlatform);
+            if(streamOk)
+            {
+                stream.getFirstPacket();
+                stream.getNextPacket();
+            }
+            nsecs = timer.nsecsElapsed();
+            if(streamOk && ((streamBest == 0) || (nsecs < streamBest)))
+                streamBest = nsecs;
+            if(batchOk != streamOk)
+            {
+                out << QString("%1 to %2 version %3 accepted by only one transcode\n").arg(oldPlatform, 2, 16).arg(newPlatform, 2, 16).arg(version);
+                ok = false;
+                continue;
+            }
+            if(!batchOk)
+                continue;
+            checked++;
+            bool same = (batch.getFirstPacket() == stream.getFirstPacket());
+            for(QByteArray packet = batch.getNextPacket(); same && !packet.isEmpty(); packet = batch.getNextPacket())
+                same = (packet == stream.getNextPacket());
+            same = same && stream.getNextPacket().isEmpty();
+            if(same && batch.encodePackets() && stream.encodePackets())
+            {
+                for(QByteArray frame = batch.getFirstFrame(); same && !frame.isEmpty(); frame = batch.getNextFrame())
+                    same = (frame == ((batch.getOffset() == 0) ? stream.getFirstFrame() : stream.getNextFrame()));
+            }
+            if(!same)
+            {
+                out << QString("%1 to %2 version %3 streaming output differs\n").arg(oldPlatform, 2, 16).arg(newPlatform, 2, 16).arg(version);
+                ok = false;
+            }
+        }
+    }
+    out << QString("%1 %2 ms batch %3 ms streaming, %4 images %5\n")
+           .arg("time to first data packet", -32)
+           .arg(batchBest / 1e6, 10, 'f', 3)
+           .arg(streamBest / 1e6, 8, 'f', 3)
+           .arg(checked)
+           .arg(ok ? "identical" : "FAILED");
+    out.flush();
+    return ok;
+}
+/* benchmarkFirmwareCache - time flashing the same file to several scanners through the image cache
+		The transfers run one after another, then at the same time from threads. Each file and
+		target must be loaded once, every transfer walks its own cursor over all the frames.
+*/
+static bool benchmarkFirmwareCache(QTextStream &out, const QString &fileName, int transfers, int threads)
+{
+    GREFirmwareCache cache;
+    std::atomic<qint64> frames(0);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    QElapsedTimer timer;
+    auto transfer = [&cache, &fileName, &frames, &failures]() {
+        GREFirmwareCache::Error error;
+        GREFirmware firmware;
+        if(!firmware.attach(cache.acquire(fileName, 0xE4, 0xE6, true, error)))
+        {
+            failures++;
+            return;
+        }
+        for(QByteArray frame = firmware.getFirstFrame(); !frame.isEmpty(); frame = firmware.getNextFrame())
+            frames++;
+    };
+    timer.start();
+    for(int i = 0; i < transfers; i++)
+        transfer();
+    qint64 sequential = timer.nsecsElapsed();
+    cache.clear();
+    timer.start();
+    for(int i = 0; i < threads; i++)
+        workers.emplace_back(transfer);
+    for(std::thread &worker : workers)
+        worker.join();
+    qint64 concurrent = timer.nsecsElapsed();
+    bool ok = (failures == 0) && (cache.getLoadCount() == 2);   // once before and once after the clear
+    out << QString("%1 %2 ms %3 in a row, %4 ms %5 at once, %6 loads %7\n")
+           .arg("transcoded image cache", -32)
+           .arg(sequential / 1e6, 10, 'f', 3)
+           .arg(transfers)
+           .arg(concurrent / 1e6, 8, 'f', 3)
+           .arg(threads)
+           .arg(cache.getLoadCount())
+           .arg(ok ? "ok" : "FAILED");
+    out.flush();
+    return ok;
+}
+/* benchmarkCatalogue - time cataloguing a directory of firmware files, cold and from the saved index
+		The warm scan must not open any file, not even the invalid one, and the latest version must be found
+*/
+static bool benchmarkCatalogue(QTextStream &out, int files)
+{
+    QDir dir(QDir::temp().filePath("GREFwToolBenchmarkCatalogue"));
+    QString indexName = dir.filePath("firmware.idx");
+    QElapsedTimer timer;
+    bool ok = true;
+    qint32 versionOffset = 0;
+    quint8 versionKey = 0;
+    GREFirmware::getVersionFormat(0xE6, versionOffset, versionKey);
+    dir.removeRecursively();
+    dir.mkpath(".");
+    for(int i = 0; i < files; i++)
+    {
+        QFile file(dir.filePath(QString("WS1080_%1.BIN").arg(i, 4, 10, QLatin1Char('0'))));
+        QByteArray image(GREFirmware::HEADER_SIZE + 1024, '\0');
+        image[0] = '\xE6';
+        image[2] = 0x04;    // 1024 byte image
+        image[GREFirmware::HEADER_SIZE + versionOffset] = static_cast<char>((i % 200) ^ versionKey);
+        if(i == (files - 1))
+            image[0] = '\xEE';   // version format unknown, must be catalogued as version 0
+        if(file.open(QIODevice::WriteOnly))
+            file.write(image);
+    }
+    QFile padded(dir.filePath("WS1080_PADDED.BIN"));
+    if(padded.open(QIODevice::WriteOnly))
+        padded.write(QByteArray(GREFirmware::HEADER_SIZE + 2048, '\xE6'));     // the size in the header does not match
+    padded.close();
+    GREFirmwareCatalogue cold(indexName);
+    timer.start();
+    cold.scan(QStringList() << dir.path());
+    cold.saveIndex();
+    qint64 coldTime = timer.nsecsElapsed();
+    GREFirmwareCatalogue warm(indexName);
+    timer.start();
+    warm.loadIndex();
+    bool warmChanged = warm.scan(QStringList() << dir.path());
+    qint64 warmTime = timer.nsecsElapsed();
+    timer.start();
+    int latest = warm.findLatest(0xE6);
+    qint64 findTime = timer.nsecsElapsed();
+    ok = (cold.getHeaderReads() == static_cast<quint32>(files + 1)) && (warm.getHeaderReads() == 0) && !warmChanged &&
+            (warm.getEntryCount() == files + 1) && (latest >= 0) && (warm.getEntry(latest).version == qMin(files, 200) - 1) &&
+            (warm.findLatest(0xEE) >= 0) && (warm.getEntry(warm.findLatest(0xEE)).version == 0);
+    out << QString("%1 %2 ms cold %3 ms from index %4 us latest %5\n")
+           .arg(QString("%1 files").arg(files), -32)
+           .arg(coldTime / 1e6, 10, 'f', 3)
+           .arg(warmTime / 1e6, 8, 'f', 3)
+           .arg(findTime / 1e3, 8, 'f', 1)
+           .arg(ok ? "ok" : "FAILED");
+    out.flush();
+    dir.removeRecursively();
+    return ok;
+}
+/* benchmarkArchive - time decoding a bundled firmware archive, the whole file and just its header
+*/
+static void benchmarkArchive(QTextStream &out, const QString &fileName)
+{
+    QByteArray data;
+    qint64 best = 0;
+    qint64 headerBest = 0;
+    qint64 size = 0;
+    bool ok = true;
+    QElapsedTimer timer;
+    for(int r = 0; r < repeatCount && ok; r++)
+    {
+        timer.start();
+        ok = GRE7zArchive::readFile(fileName, data);
+        qint64 nsecs = timer.nsecsElapsed();
+        if((best == 0) || (nsecs < best))
+            best = nsecs;
+        timer.start();
+        ok = ok && GRE7zArchive::readFile(fileName, data, GREFirmware::HEADER_SIZE + GREFirmware::getVersionReadSize(), &size);
+        nsecs = timer.nsecsElapsed();
+        if((headerBest == 0) || (nsecs < headerBest))
+            headerBest = nsecs;
+    }
+    if(!ok)
+    {
+        out << QString("%1 failed\n").arg(QFileInfo(fileName).fileName(), -32);
+        return;
+    }
+    out << QString("%1 %2 MB/s %3 ms whole file %4 ms header\n")
+           .arg(QFileInfo(fileName).fileName(), -32)
+           .arg(size / (best / 1e9) / 1e6, 10, 'f', 1)
+           .arg(best / 1e6, 8, 'f', 3)
+           .arg(headerBest / 1e6, 8, 'f', 3);
+    out.flush();
+}
+/* benchmarkTranscodeCheck - time checking the bundled firmware against every transcode, one thread and the pool
+		Unsupported versions are reported, the streaming and round trip transcodes must always agree
+*/
+static bool benchmarkTranscodeCheck(QTextStream &out, const QStringList &fileNames)
+{
+    QVector<GRETranscodeCheck::Result> results;
+    QElapsedTimer timer;
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    bool ok = true;
+    QThreadPool::globalInstance()->setMaxThreadCount(1);
+    timer.start();
+    GRETranscodeCheck::run(fileNames);
+    qint64 single = timer.nsecsElapsed();
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    timer.start();
+    results = GRETranscodeCheck::run(fileNames);
+    qint64 pool = timer.nsecsElapsed();
+    foreach(const GRETranscodeCheck::Result &result, results)
+    {
+        out << "    " << GRETranscodeCheck::formatResult(result) << "\n";
+        if((result.status == GRETranscodeCheck::STATUS_STREAM_MISMATCH) || (result.status == GRETranscodeCheck::STATUS_ROUND_TRIP_MISMATCH))
+            ok = false;
+    }
+    out << QString("%1 %2 ms 1 thread %3 ms %4 threads %5\n")
+           .arg(QString("%1 checks").arg(results.size()), -32)
+           .arg(single / 1e6, 10, 'f', 3)
+           .arg(pool / 1e6, 8, 'f', 3)
+           .arg(threads)
+           .arg(ok ? "ok" : "FAILED");
+    out.flush();
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    QByteArray dataPacket(100, 'A');
+    QByteArray statusResponse;
+    QByteArray versionResponse;
+    Random random(5);
+    appendResponse(statusResponse, 'A', random);
+    appendResponse(versionResponse, 'V', random);
+    const QDateTime dateTime(QDate(2016, 7, 4), QTime(12, 30, 15));
+
+    out << "GREFwTool benchmark, best of " << repeatCount << " runs\n\n";
+
+    out << "GREParser::processResponse\n";
+    printResult(out, "bootloader ENQ/ACK flood", runStream(makeBootloaderFlood(streamSize)));
+    printResult(out, "A/L/V/P response mix", runStream(makeResponseMix(streamSize, 2)));
+    printResult(out, "A/L/V/P mix, 1 error per 1 KiB", runStream(makeDamagedMix(streamSize, 1024)));
+    printResult(out, "CCDump text", runStream(makeCCDump(streamSize)));
+    printResult(out, "CCDump text to file", runCCDumpSink(makeCCDump(streamSize)));
+    printResult(out, "garbage", runStream(makeGarbage(streamSize)));
+
+    out << "\nGREParser::processCommand\n";
+    // requests are answered so the next one can leave the request queue
+    benchmarkCommand(out, "getStatus and response", [&statusResponse](GREParser &parser) { parser.getStatus(); parser.receiveData(statusResponse); });
+    benchmarkCommand(out, "requestVersion and response", [&versionResponse](GREParser &parser) { parser.requestVersion(); parser.receiveData(versionResponse); });
+    benchmarkCommand(out, "setDateTime", [&dateTime](GREParser &parser) { parser.setDateTime(dateTime); });
+    benchmarkCommand(out, "sendPacket 100 hex characters", [&dataPacket](GREParser &parser) { parser.sendPacket(dataPacket); });
+
+    out << "\nACK to next firmware packet dispatch\n";
+    benchmarkDispatch(out, "SIGNAL/SLOT string connections", true);
+    benchmarkDispatch(out, "member pointer, direct", false);
+
+    out << "\nGRELCDMirror::diffFrames\n";
+    benchmarkLCDDiff(out, "static screen", 0);
+    benchmarkLCDDiff(out, "clock tick", 2);
+    benchmarkLCDDiff(out, "full redraw", GREParser::LCD_SIZE);
+
+    out << "\nGRETrace::record\n";
+    benchmarkTrace(out, "full bytes");
+    bool cached = false;
+    bool preflighted = false;
+    out << "\nGREFirmware::load\n";
+    QString firmwareName = QDir::temp().filePath("GREFwToolBenchmark.BIN");
+    QFile firmwareFile(firmwareName);
+    if(firmwareFile.open(QIODevice::WriteOnly))
+    {
+        QByteArray image = makeGarbage(firmwareImageSize);
+        const char header[GREFirmware::HEADER_SIZE] = { '\xE4', static_cast<char>(firmwareImageSize >> 16),
+                                                        static_cast<char>(firmwareImageSize >> 8), static_cast<char>(firmwareImageSize) };
+        firmwareFile.write(header, GREFirmware::HEADER_SIZE);
+        firmwareFile.write(image);
+        firmwareFile.close();
+        benchmarkFirmwareLoad(out, "2 MiB image", firmwareName, 0);
+        benchmarkFirmwareLoad(out, "2 MiB image and transcode", firmwareName, 0xE6);
+        cached = benchmarkFirmwareCache(out, firmwareName, 20, qMax(2, QThread::idealThreadCount()));
+        out << "\nGREFirmware::preflight\n";
+        preflighted = benchmarkPreflight(out, "2 MiB image", firmwareName, 0, false) &&
+                benchmarkPreflight(out, "2 MiB image, transcode and frames", firmwareName, 0xE6, true);
+        QFile::remove(firmwareName);
+    }
+
+    out << "\nGREFirmware::transcode\n";
+    benchmarkTranscode(out, "byte loop", true);
+    benchmarkTranscode(out, "XOR kernel", false);
+
+    out << "\nGREFirmware packets, 2 MiB image\n";
+    benchmarkPackets(out, "getNextPacket and sendPacket", false);
+    benchmarkPackets(out, "pre-encoded getNextFrame", true);
+
+    out << "\nGREFirmwareCatalogue::scan\n";
+    bool catalogued = benchmarkCatalogue(out, 500);
+
+    out << "\nGRE7zArchive::readFile, bundled firmware\n";
+    foreach(const QFileInfo &archive, QDir(QStringLiteral(FIRMWARE_DIR)).entryInfoList(QStringList() << QStringLiteral("*.7z"), QDir::Files, QDir::Name))
+        benchmarkArchive(out, archive.filePath());
+
+    out << "\nGREFirmware::preflight, bundled firmware to the Pro-668\n";
+    foreach(const QFileInfo &archive, QDir(QStringLiteral(FIRMWARE_DIR)).entryInfoList(QStringList() << QStringLiteral("*.7z"), QDir::Files, QDir::Name))
+        benchmarkPreflight(out, archive.fileName(), archive.filePath(), 0xE4, true);
+
+    out << "\nGRETranscodeCheck::run, bundled firmware\n";
+    QStringList bundled;
+    foreach(const QFileInfo &file, QDir(QStringLiteral(FIRMWARE_DIR)).entryInfoList(QStringList() << QStringLiteral("*.7z") << QStringLiteral("*.BIN"), QDir::Files, QDir::Name))
+        bundled << file.filePath();
+    bool checked = benchmarkTranscodeCheck(out, bundled);
+
+    out << "\nGREFirmware streaming transcode\n";
+    bool verified = verifyStreamTranscode(out);
+
+    out << "\nGREParser one per thread, interleaved response streams\n";
+    int maxThreads = qMax(1, QThread::idealThreadCount());
+    QVector<QByteArray> streams;
+    QVector<qint64> expected;
+    bool threaded = true;
+    for(int i = 0; i < maxThreads; i++)
+    {
+        streams.append(makeResponseMix(streamSize / 4, 100 + i));
+        expected.append(runStream(streams.last()).events);
+    }
+    for(int threads = 1; threads <= maxThreads; threads *= 2)
+        printResult(out, QString("%1 threads").arg(threads, 2), runThreads(threads, streams, expected, threaded));
+    out << QString("%1 %2\n").arg("events match one parser alone", -32).arg(threaded ? "ok" : "FAILED");
+    out.flush();
+
+    // Optional capture files recorded with Tools/Capture Protocol are replayed at full speed
+    QStringList captures = a.arguments().mid(1);
+    if(!captures.isEmpty())
+        out << "\nGREParser capture replay\n";
+    foreach(const QString &fileName, captures)
+    {
+        bool ok;
+        Result result = runCapture(fileName, ok);
+        if(ok)
+            printResult(out, QFileInfo(fileName).fileName(), result);
+        else
+            out << fileName << " is not a protocol capture file\n";
+    }
+    return (verified && cached && preflighted && catalogued && checked && threaded) ? 0 : 1;
+}
+
+#include "benchmark.moc"
@@ -0,0 +1,63 @@
+/* gre7zarchive.h - A minimal reader for single file 7z firmware archives
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRE7ZARCHIVE_H
+#define GRE7ZARCHIVE_H
+
+#include <QByteArray>
+#include <QString>
+
+class GRE7zArchive
+{
+public:
+    GRE7zArchive();
+    ~GRE7zArchive();
+    bool open(const QByteArray &archive);
+    QString getName() const { return name; }
+    qint64 getUnpackSize() const { return unpackSize; }
+    QString getErrorString() const { return errorString; }
+    bool extract(QByteArray &data, qint64 length = -1) const;
+    static bool isArchiveName(const QString &fileName);
+    static bool readFile(const QString &fileName, QByteArray &data, qint64 length = -1, qint64 *unpackSize = nullptr,
+                         QString *errorString = nullptr);
+
+    enum {
+        SIGNATURE_HEADER_SIZE = 32,
+        MAX_UNPACK_SIZE = 4 + 0xffffff  // a firmware header and the largest image its 24 bit size allows
+    };
+
+private:
+    Q_DISABLE_COPY(GRE7zArchive)
+    bool readHeader(const quint8 *p, const quint8 *end);
+    bool setError(const QString &message) const;
+
+    QByteArray archiveData;         // a reference to the archive bytes passed to open
+    quint64 packOffset;             // of the packed stream after the signature header
+    quint64 packSize;
+    qint64 unpackSize;
+    quint64 coder;                  // 7z coder id
+    QByteArray coderProperties;
+    bool crcDefined;
+    quint32 crc;                    // of the unpacked data
+    QString name;
+    mutable QString errorString;    // why the last open or extract failed
+};
+
+#endif // GRE7ZARCHIVE_H
@@ -0,0 +1,96 @@
+/* grecapture.h - Binary protocol capture and replay classes
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRECAPTURE_H
+#define GRECAPTURE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "grefilewriter.h"
+
+class GREParser;
+
+/* Capture file format, all values little endian
+		File header: 8 byte magic "GRECAP01"
+		Record: quint64 nanoseconds since capture start, quint8 direction, quint32 length, data bytes
+*/
+namespace GRECaptureFormat {
+const char magic[] = "GRECAP01";
+const int magicSize = 8;
+const int recordHeaderSize = 13;
+
+enum Direction {
+    DIRECTION_RX = 0,
+    DIRECTION_TX = 1
+};
+}
+
+class GRECapture : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GRECapture(QObject *parent = 0);
+    ~GRECapture();
+    bool start(const QString &fileName);
+    void stop();
+    bool isActive() const { return fileWriter.isStarted(); }
+    void record(GRECaptureFormat::Direction direction, const char *data, int length);
+    quint64 getRecordCount() const { return recordCount; }
+
+private:
+    QElapsedTimer clock;
+    quint64 recordCount;
+    GREFileWriter fileWriter;
+};
+
+class GRECaptureReplay : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GRECaptureReplay(GREParser *parser, QObject *parent = 0);
+    ~GRECaptureReplay();
+    bool open(const QString &fileName);
+    void start(bool recordedSpeed);
+    void stop();
+    bool isActive() const { return active; }
+
+signals:
+    void replayTx(const QByteArray &data);
+    void replayRx(const QByteArray &data);
+    void finished();
+
+private slots:
+    void replayNext();
+
+private:
+    bool readRecord(quint64 &timestamp, quint8 &direction, QByteArray &data);
+    void deliver(quint8 direction, const QByteArray &data);
+
+    GREParser *parser;
+    QByteArray capture;
+    int position;
+    bool active;
+    bool realTime;
+    QElapsedTimer clock;
+};
+
+#endif // GRECAPTURE_H
@@ -0,0 +1,79 @@
+/* greccdump.h - CCDump line decoder and file sink class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRECCDUMP_H
+#define GRECCDUMP_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "grefilewriter.h"
+
+/* GRECCDump splits control channel dump lines into records and streams them to a tab separated file.
+		Every line is passed on for display until a file is streamed, then only one line per
+		SAMPLE_INTERVAL is, so a sustained dump to file does not load the GUI.
+*/
+class GRECCDump : public QObject
+{
+    Q_OBJECT
+public:
+    // A CCDump line "tag: field field ..." as views into the line
+    struct Record {
+        const char *tag;
+        int tagLength;
+        const char *fields;
+        int fieldsLength;
+    };
+
+    explicit GRECCDump(QObject *parent = 0);
+    ~GRECCDump();
+    bool start(const QString &fileName);
+    void stop();
+    bool isActive() const { return fileWriter.isStarted(); }
+    void reset();
+    static bool parseLine(const char *line, int length, Record &record);
+    quint64 getLineCount() const { return lineCount; }
+    quint64 getBadLineCount() const { return badLineCount; }
+    quint64 getBytesDropped() const { return fileWriter.getBytesDropped(); }
+
+signals:
+    void sample(const QString &line, quint64 lineCount);
+    void streamFailed();
+
+public slots:
+    void processLine(const QByteArray &line);
+
+private:
+    enum {
+        SAMPLE_INTERVAL = 500,      // ms between lines passed on for display while streaming
+        LINE_BUFFER_SIZE = 512      // longest formatted file line, longer lines are cut
+    };
+    void writeRecord(const Record &record);
+    QElapsedTimer clock;
+    qint64 lastSample;
+    bool failureReported;
+    quint64 lineCount;
+    quint64 badLineCount;
+    char lineBuffer[LINE_BUFFER_SIZE];
+    GREFileWriter fileWriter;
+};
+
+#endif // GRECCDUMP_H
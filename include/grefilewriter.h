@@ -0,0 +1,74 @@
+/* grefilewriter.h - A batched background file writer class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GREFILEWRITER_H
+#define GREFILEWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+
+class QThread;
+
+/* GREFileWriter collects appended data in memory and a low priority thread writes it out
+		in large blocks, so the caller never waits on the disk. The file is opened by start, a
+		write error later stops the writer and drops what is still appended.
+*/
+class GREFileWriter
+{
+public:
+    GREFileWriter();
+    ~GREFileWriter();
+    bool start(const QString &fileName, const QByteArray &header = QByteArray());
+    void stop();
+    bool isStarted() const { return writer != nullptr; }
+    bool isActive() const;
+    bool hasFailed() const;
+    void append(const char *data, int length);
+    void append(const char *prefix, int prefixLength, const char *data, int length);
+    quint64 getBytesWritten() const;
+    quint64 getBytesDropped() const;
+
+private:
+    Q_DISABLE_COPY(GREFileWriter)
+    friend class GREFileWriterThread;
+    void writerLoop();
+
+    enum {
+        FLUSH_SIZE = 65536,                 // wake the writer once this much is pending
+        FLUSH_INTERVAL = 250,               // otherwise the writer wakes up every FLUSH_INTERVAL ms
+        MAX_PENDING = 16 * 1024 * 1024      // drop data rather than grow without limit if the disk stalls
+    };
+    // shared with the writer thread, guarded by mutex
+    bool active;                            // appended data is accepted
+    bool stopping;
+    bool failed;                            // the file could not be written
+    QFile file;
+    mutable QMutex mutex;
+    QWaitCondition pendingReady;
+    QByteArray pending;
+    quint64 bytesWritten;
+    quint64 bytesDropped;
+    QThread *writer;
+};
+
+#endif // GREFILEWRITER_H
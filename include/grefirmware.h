@@ -22,32 +22,109 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 #define GREFIRMWARE_H
 
 #include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QSharedPointer>
+#include <QVector>
 
 class GREFirmware : public QObject
 {
     Q_OBJECT
 public:
+    // A firmware file prepared for one target platform, shared read only by any number of transfers
+    struct Image
+    {
+        QByteArray file;            // the firmware file, header included, as read from disk
+        quint8 platform;            // target platform
+        QByteArray frames;          // packet table pre-encoded for the target platform
+    };
+
+    // Checks made on the image just before an update is started
+    enum PreflightError {
+        PREFLIGHT_OK = 0,
+        PREFLIGHT_EMPTY,            // no image loaded
+        PREFLIGHT_TRANSCODE,        // no transcode from the platform of the image to the target platform
+        PREFLIGHT_VERSION,          // version byte is not a version or not in the patch table of the transcode
+        PREFLIGHT_PATCH_OFFSET,     // a version fixup is outside the image
+        PREFLIGHT_FRAMES            // the pre-encoded packet table does not match the image
+    };
+    struct Preflight
+    {
+        PreflightError error;
+        quint8 platform;            // target platform
+        quint8 version;             // major and minor nibbles, 0 if the platform version format is unknown
+        quint64 fingerprint;        // CRC-64 of the image as loaded and the target platform
+    };
+
     explicit GREFirmware(QObject *parent = 0);
     ~GREFirmware();
-    bool openFile(QString path);
+    bool load(const QString &fileName);
+    bool loadBuffer(const QByteArray &buffer);
+    bool attach(const QSharedPointer<const Image> &image);
+    void close();
+    bool isMapped() const { return mappedBytes != nullptr; }
+    QString getErrorString() const { return errorString; }
     quint8 getPlatform() { return header.platform; }
     qint32 getImageSize() { return header.imageSize; }
+    const QByteArray &getImageData() const { return imageData; }
     qint32 getOffset() { return offset; }
     bool transcode(quint8 newPlatform);
+    bool beginTranscode(quint8 newPlatform);
+    bool isStreamTranscode() const { return streamEntry >= 0; }
+    QVector<qint32> getPatchOffsets(quint8 newPlatform) const;
+    static bool isTranscodeSupported(quint8 oldPlatform, quint8 newPlatform);
+    static bool getVersionFormat(quint8 platform, qint32 &offset, quint8 &key);
+    static qint32 getVersionReadSize();
+    static quint8 decodeVersion(quint8 platform, const char *image, qint32 size);
+    static QString formatVersion(quint8 version);
+    bool preflight(Preflight &result) const;
+    static int getTranscodeCount();
+    static bool getTranscodePair(int index, quint8 &oldPlatform, quint8 &newPlatform);
+    static bool transcodeData(quint8 oldPlatform, quint8 newPlatform, char *data, int length, qint32 offset = 0);
     QByteArray &getFirstPacket();
     QByteArray &getNextPacket();
+    bool encodePackets();
+    bool hasFrames() const { return !frameTable.isEmpty(); }
+    const QByteArray &getFrameTable() const { return frameTable; }
+    QByteArray getFirstFrame();
+    QByteArray getNextFrame();
+    static quint8 encodeHex(const char *data, int length, char *hex);
+
+    enum {
+        HEADER_SIZE = 4,
+        PACKET_DATA_SIZE = 50,                          // image bytes per data packet
+        HEADER_FRAME_SIZE = 1 + 7 + 2,                  // STX, platform and hex size, ETX and checksum
+        DATA_FRAME_SIZE = 1 + 2 * PACKET_DATA_SIZE + 2  // STX, hex data, ETX and checksum
+    };
 
 private:
+    bool parseHeader(const char *bytes, qint64 size);
+    const char *packetData(int length);
+
     struct
     {
-        quint8  platform;
+        quint8  platform;       // target platform once a transcode is started
+        quint8  dataPlatform;   // platform of imageData, differs from platform during a streaming transcode
         qint32  imageSize;
     } header;
-    QByteArray imageData;
-    QString pathInfo;
+    QByteArray imageData;           // view of the mapped file or buffer until transcode makes a private copy
+    QByteArray sourceBuffer;        // keeps a buffer passed to loadBuffer alive
+    QSharedPointer<const Image> attachedImage;  // keeps an attached image alive
+    QFile imageFile;
+    uchar *mappedBytes;
+    QString errorString;            // why the last load failed
     qint32 offset;
+    int streamEntry;                // transcode table entry applied as packets are produced, -1 if none
+    struct
+    {
+        qint32 offset;
+        quint8 data;
+    } streamPatches[4];             // version fixups applied as packets are produced
+    int streamPatchCount;
+    char window[PACKET_DATA_SIZE];  // the current packet data after the streaming transcode
     QByteArray headerPacket;
     QByteArray dataPacket;
+    QByteArray frameTable;          // every packet of the image framed for sending, header first
 
 };
 
@@ -0,0 +1,90 @@
+/* grefirmwarecache.h - A shared cache of firmware images prepared for update
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GREFIRMWARECACHE_H
+#define GREFIRMWARECACHE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include "grefirmware.h"
+
+/* GREFirmwareCache keeps firmware images keyed by the SHA-256 of the file contents and the target
+		platform. Each image is loaded, transcoded and pre-encoded once, then shared read only
+		with every transfer that asks for it. Each transfer attaches it to its own GREFirmware,
+		which is only a cursor. acquire may be called from any thread, the lock is only held to
+		look up and insert, so reading and preparing one image does not block acquiring another.
+*/
+class GREFirmwareCache : public QObject
+{
+    Q_OBJECT
+public:
+    enum Error {
+        ERROR_NONE = 0,
+        ERROR_LOAD,             // file not readable or the header does not match the file
+        ERROR_PLATFORM,         // file is not for the expected platform
+        ERROR_TRANSCODE,        // transcode not supported for this platform pair or firmware version
+        ERROR_ENCODE            // the packet table could not be built
+    };
+
+    explicit GREFirmwareCache(QObject *parent = 0);
+    ~GREFirmwareCache();
+    QSharedPointer<const GREFirmware::Image> acquire(const QString &fileName, quint8 filePlatform, quint8 platform, bool preEncode, Error &error,
+                                                     QString *errorString = nullptr);
+    void clear();
+    QByteArray getFileHash(const QString &fileName);
+    int getImageCount();
+    quint32 getLoadCount();
+    quint32 getHitCount();
+
+private:
+    enum {
+        MAX_IMAGES = 4          // least recently used images are dropped beyond this
+    };
+    struct FileHash {
+        qint64 size;
+        QDateTime modified;
+        QByteArray hash;
+    };
+    struct CacheEntry {
+        QSharedPointer<const GREFirmware::Image> image;
+        quint64 lastUse;
+    };
+    static bool readFile(const QString &fileName, QByteArray &file, QByteArray &hash, QString &errorString);
+    static QSharedPointer<const GREFirmware::Image> prepareImage(const QByteArray &file, quint8 filePlatform, quint8 platform, bool preEncode,
+                                                                 Error &error, QString &errorString);
+
+    QMutex mutex;
+    QWaitCondition prepared;                // woken when an image in preparing is done
+    QSet<QByteArray> preparing;             // keys of images being prepared outside the lock
+    QHash<QString, FileHash> fileHashes;    // by canonical file path, so unchanged files are not read again
+    QHash<QByteArray, CacheEntry> images;   // by content hash and target platform
+    quint64 useCount;
+    quint32 loadCount;
+    quint32 hitCount;
+};
+
+#endif // GREFIRMWARECACHE_H
@@ -0,0 +1,73 @@
+/* grefirmwarecatalogue.h - An index of the firmware files on disk built from their headers
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GREFIRMWARECATALOGUE_H
+#define GREFIRMWARECATALOGUE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/* GREFirmwareCatalogue lists the firmware files and 7z firmware archives found in a set of
+		directories. Only the header and the version byte of a file are read, and only when the
+		file is new or changed since the last scan. A file that is not a valid firmware file is
+		kept as an invalid entry, so it is not read again until it changes. The catalogue is kept
+		in a tab separated index file between sessions.
+*/
+class GREFirmwareCatalogue : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        QString path;
+        qint64 modified;        // ms since the epoch
+        qint64 size;
+        bool valid;             // the header matches the file, the other fields are only set if it does
+        quint8 platform;
+        quint8 version;         // major and minor nibbles, 0 if the platform version format is unknown
+        QByteArray hash;        // SHA-256 of the file, empty until the file has been loaded
+    };
+
+    explicit GREFirmwareCatalogue(const QString &indexFileName, QObject *parent = 0);
+    ~GREFirmwareCatalogue();
+    bool loadIndex();
+    bool saveIndex();
+    bool scan(const QStringList &directories);
+    void setHash(const QString &path, const QByteArray &hash);
+    int getEntryCount() const { return entries.size(); }
+    const Entry &getEntry(int index) const { return entries.at(index); }
+    int findLatest(quint8 platform) const;
+    quint32 getHeaderReads() const { return headerReads; }
+
+private:
+    bool readHeader(const QString &path, Entry &entry);
+    void rebuildPaths();
+
+    QString indexFileName;
+    QVector<Entry> entries;
+    QHash<QString, int> paths;      // path to index in entries
+    bool modified;                  // entries changed since the index was loaded or saved
+    quint32 headerReads;
+};
+
+#endif // GREFIRMWARECATALOGUE_H
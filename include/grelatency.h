@@ -0,0 +1,59 @@
+/* grelatency.h - A low overhead log-linear latency histogram class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRELATENCY_H
+#define GRELATENCY_H
+
+#include <QtGlobal>
+#include <QString>
+
+/* GRELatencyHistogram counts latencies in microseconds in HDR style log-linear buckets.
+		Every power of two range is split in SUB_BUCKET_COUNT linear buckets, so a value is
+		reported within about 3% at any magnitude. Recording is a few shifts and an increment.
+*/
+class GRELatencyHistogram
+{
+public:
+    GRELatencyHistogram();
+    void record(quint32 usecs);
+    void reset();
+    quint64 getCount() const { return count; }
+    quint32 getMin() const { return (count == 0) ? 0 : minValue; }
+    quint32 getMax() const { return maxValue; }
+    quint32 getMean() const { return (count == 0) ? 0 : static_cast<quint32>(total / count); }
+    quint32 percentile(double percent) const;
+    QString summary() const;
+
+private:
+    enum {
+        SUB_BUCKET_BITS = 5,
+        SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,                    // linear buckets per power of two
+        BUCKET_COUNT = (32 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT + SUB_BUCKET_COUNT  // covers all quint32 values
+    };
+    static int bucketIndex(quint32 value);
+    static quint32 bucketValue(int index);
+    quint32 counts[BUCKET_COUNT];
+    quint64 count;
+    quint64 total;
+    quint32 minValue;
+    quint32 maxValue;
+};
+
+#endif // GRELATENCY_H
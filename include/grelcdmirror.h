@@ -0,0 +1,82 @@
+/* grelcdmirror.h - LCD polling and frame diffing class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRELCDMIRROR_H
+#define GRELCDMIRROR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "greparser.h"
+
+/* GRELCDMirror polls the scanner LCD as fast as the link answers and compares each frame with the
+		previous one. Only the changed byte ranges and icon bits are reported, nothing at all for a static screen.
+*/
+class GRELCDMirror : public QObject
+{
+    Q_OBJECT
+public:
+    enum {
+        MAX_RANGES = 8,             // more changed ranges than this are merged into the last one
+        RANGE_GAP = 4               // ranges closer than this are merged
+    };
+    struct Range {
+        quint8 first;
+        quint8 last;                // inclusive
+    };
+    struct Changes {
+        int rangeCount;
+        Range ranges[MAX_RANGES];   // changed LCD bytes
+        quint32 iconMask;           // changed icon bits, bit n is bit n % 8 of icon byte n / 8
+    };
+
+    explicit GRELCDMirror(GREParser *parser, QObject *parent = 0);
+    ~GRELCDMirror();
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+    static void diffFrames(const GREParser::GetLCDVal &previous, const GREParser::GetLCDVal &frame, Changes &changes);
+
+signals:
+    void frameChanged(const GREParser::GetLCDVal &frame, const GRELCDMirror::Changes &changes);
+    void frameRate(double fps);
+
+private slots:
+    void processLCD(const GREParser::GetLCDVal &frame);
+    void pollTimeout();
+
+private:
+    enum {
+        POLL_TIMEOUT = 500,         // ms to wait for a response before polling again
+        RATE_INTERVAL = 1000        // ms between frame rate reports
+    };
+    GREParser *parser;
+    bool active;
+    bool havePrevious;
+    GREParser::GetLCDVal previous;
+    QTimer *pollTimer;
+    QElapsedTimer rateClock;
+    int rateFrames;
+};
+
+Q_DECLARE_METATYPE(GRELCDMirror::Changes)
+
+#endif // GRELCDMIRROR_H
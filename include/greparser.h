@@ -23,9 +23,19 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 
 #include <QObject>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QVector>
 #include <QMap>
 
+#include "greprotocol.h"
+#include "grelatency.h"
+
+class GRERingBuffer;
+class QTimer;
+
+/* GREParser keeps all framing state in the instance, so one parser can be used per scanner
+		and each parser can live in its own thread (moveToThread) without any locking.
+*/
 class GREParser : public QObject
 {
     Q_OBJECT
@@ -44,27 +54,57 @@ public:
         quint8 rxmode;
     };
 
+    enum {
+        LCD_SIZE = 97,
+        LCD_ICON_SIZE = 3
+    };
     struct GetLCDVal {
-        QByteArray lcd;
-        QByteArray icons;
+        quint8 lcd[LCD_SIZE];
+        quint8 icons[LCD_ICON_SIZE];
     };
+    // Raw version bytes, use formatVersion to get the display text
     struct VersionVal {
-        QString model;
-        QString ver1;
-        QString ver2;
-        QString ver3;
-        QString ver4;
+        char model[8];      // not zero terminated when all 8 characters are used
+        quint8 version[4];  // Boot, CPU, DSP and Voice as major/minor nibbles, 0 is N/A and 255 is erased
+                            // from the bootloader: Boot and CPU as two ASCII digits each
+        bool bootloader;
+    };
+
+    // Latency histograms, one per command in GREProtocol::messageTable order and two for firmware updates
+    enum {
+        LATENCY_PACKET = GREProtocol::messageTableSize, // firmware packet sent to ACK or NAK received
+        LATENCY_TURNAROUND,                             // ENQ or ACK received to next firmware packet sent
+        LATENCY_COUNT
+    };
+
+    // Receive error counters for judging the serial link
+    struct LinkStats {
+        quint32 checksumErrors;
+        quint32 lengthErrors;       // known length responses without ETX at the end, and runaway frames
+        quint32 resyncEvents;       // packet starts found again inside a failed frame
+        quint64 bytesDiscarded;     // bytes that were neither part of a good frame nor a known indication
     };
 
     explicit GREParser(QObject *parent = 0);
     ~GREParser();
     void initialize();
+    void initializeReplay();
     void initializeWork();
     void setDateTime(const QDateTime &datetime);
-    void receiveData(QByteArray &data);
+    void receiveData(const QByteArray &data);
+    void receiveData(GRERingBuffer &buffer);
+    static QString formatVersion(const VersionVal &data);
+    const LinkStats &getLinkStats() const { return linkStats; }
+    int getQueuedCount() const { return queueCount; }
+    int getInFlightCount() const { return inFlightCount; }
+    quint32 getUnsolicitedCount() const { return unsolicitedCount; }
+    quint32 getDroppedCount() const { return droppedCount; }
+    const GRELatencyHistogram &getLatency(int slot) const { return latency[slot]; }
+    static QString latencyName(int slot);
+    void resetLatency();
 
 signals:
-    void sendData(const QByteArray &data);
+    void sendData(const QByteArray &data); // view of the command buffer, copy it to keep it
     void updateEOT(void );
     void updateEnq(void );
     void updateAck(void );
@@ -76,7 +116,11 @@ signals:
     void updateLCD(const GREParser::GetLCDVal &data);
     void updatePowerStatus(const bool &data);
     void updateVersion(const GREParser::VersionVal &data);
-    void updateCCDump(const QString &data);
+    void updateCCDump(const QByteArray &line); // line including its end, copy it to keep it
+    void updateFrame(const QByteArray &frame); // view of the frame buffer, copy it to keep it
+    void updateFrameError(const QByteArray &frame); // view of the bytes of a damaged frame after its STX
+    void requestTimeout(char command);
+    void updateReady(bool bootloader, qint64 msecs);   // scanner mode known, msecs since initialize
 
 public slots:
     void setCCDump(bool enable);
@@ -86,9 +130,14 @@ public slots:
     void requestVersion(void );
     void clearPassword(void );
     void sendPacket(const QByteArray &data);
+    void sendFrame(const QByteArray &frame);
     void sendAck();
     void sendNak();
 
+private slots:
+    void processRequestTimeout();
+    void processDetectTimeout();
+
 private:
     enum {
         MODE_WAIT_START = 0,
@@ -98,17 +147,81 @@ private:
         MODE_CCDUMP_START,
         MODE_CCDUMP_DATA,
     } mode;
+    enum {
+        COMMAND_BUFFER_SIZE = 128,      // largest command is the 100 character firmware data packet
+        RESPONSE_BUFFER_SIZE = 128,     // largest response is the 100 byte LCD response
+        CCDUMP_RESERVE_SIZE = 256,
+        REQUEST_SIZE = 20,              // largest queued command is Set Date and Time
+        REQUEST_QUEUE_SIZE = 16,
+        PIPELINE_DEPTH = 2,             // responses outstanding at once, each for a different command
+        DETECT_TIMEOUT = 2000           // ms after which the application mode is assumed
+    };
+    // A command waiting for its turn to be sent
+    struct Request {
+        char data[REQUEST_SIZE];
+        int length;
+    };
+    // A sent command waiting for its response
+    struct InFlight {
+        char command;
+        int latencySlot;
+        qint64 deadline;                // ms on requestClock
+    };
     bool bootloaderActive; // CPU Application update mode
-    void processCommand(const QByteArray &data);
-    void processResponse(const QByteArray &data);
-    QByteArray  commandData;
-    QByteArray  responseData;
+    bool detecting;        // scanner mode not known yet after initialize
+    bool replaying;        // responses come from a capture replay, nothing is sent
+    void processCommand(const char *data, int length, int latencySlot);
+    void queueCommand(const char *data, int length);
+    void dispatchRequests();
+    void completeRequest(char command);
+    void clearRequests();
+    void startRequestTimer();
+    void reset();
+    void finishDetection();
+    void processResponse(const char *data, int length);
+    void resyncFrame(const char *tail, int tailLength);
+    template<char Command> void sendCommand();
+    template<char Command, int Length> void sendCommand(const unsigned char (&payload)[Length]);
+    typedef void (GREParser::*ResponseDecoder)(const QByteArray &responseData);
+    static const ResponseDecoder responseDecoders[GREProtocol::DECODE_COUNT];
+    void decodeStatus(const QByteArray &responseData);
+    void decodeLcd(const QByteArray &responseData);
+    void decodePowerStatus(const QByteArray &responseData);
+    void decodeVersion(const QByteArray &responseData);
+    void decodeBootloaderVersion(const QByteArray &responseData);
+    void startLatency(int slot);
+    void stopLatency(int slot);
+    char commandBuffer[COMMAND_BUFFER_SIZE];
+    char responseBuffer[RESPONSE_BUFFER_SIZE];
+    int responseLength;
+    int dataLength;                 // expected response length, -1 when ended by ETX
+    unsigned char responseChecksum;
+    LinkStats linkStats;
+    int updateFlagCount;            // count of 'C' CPU update mode indications
     QDateTime lastDate;
     GetStatusVal lastGetStatusVal;
     GetLCDVal lastGetLCDVal;
     bool lastPowerStatusVal;
     VersionVal lastVersionVal;
-    QString lastCCDump;
+    QByteArray lastCCDump;
+    Request requestQueue[REQUEST_QUEUE_SIZE];
+    int queueHead;
+    int queueCount;
+    InFlight inFlight[PIPELINE_DEPTH];
+    int inFlightCount;
+    quint32 unsolicitedCount;
+    quint32 droppedCount;           // queued requests not valid in the scanner mode when their turn came
+    QTimer *requestTimer;
+    qint64 requestTimerDeadline;    // when the running request timer expires
+    QTimer *detectTimer;
+    QElapsedTimer connectClock;
+    QElapsedTimer requestClock;
+    qint64 latencyStart[LATENCY_COUNT];     // ns on requestClock, -1 when nothing is outstanding
+    GRELatencyHistogram latency[LATENCY_COUNT];
 };
 
+Q_DECLARE_METATYPE(GREParser::GetStatusVal)
+Q_DECLARE_METATYPE(GREParser::GetLCDVal)
+Q_DECLARE_METATYPE(GREParser::VersionVal)
+
 #endif // GREPARSER_H
@@ -0,0 +1,127 @@
+/* greprotocol.h - GRE scanner protocol constants and message descriptor table
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GREPROTOCOL_H
+#define GREPROTOCOL_H
+
+#include <QtGlobal>
+
+namespace GREProtocol {
+
+// Framing and firmware update control bytes
+enum ControlByte {
+    STX = 0x02,     // packet start
+    ETX = 0x03,     // packet data end
+    EOT = 0x04,     // firmware update complete
+    ENQ = 0x05,     // firmware update wait
+    ACK = 0x06,     // packet acknowledgement
+    DLE = 0x10,     // firmware update start
+    NAK = 0x15,     // packet negative acknowledgement
+    CAN = 0x18      // firmware update cancel
+};
+
+// Scanner modes a command may be sent in
+enum ModeFlag {
+    MODE_APPLICATION = 0x01,
+    MODE_BOOTLOADER = 0x02
+};
+
+// Response decoders, GREParser keeps the matching decoder functions in the same order
+enum Decoder {
+    DECODE_NONE = 0,
+    DECODE_STATUS,
+    DECODE_LCD,
+    DECODE_POWER_STATUS,
+    DECODE_VERSION,
+    DECODE_COUNT
+};
+
+struct MessageInfo {
+    char command;
+    qint8 requestLength;    // payload bytes after the command byte, -1 if it depends on the mode
+    qint16 responseLength;  // response bytes including the command byte, -1 if ended by ETX
+    quint8 modes;
+    Decoder decoder;
+    quint16 timeout;        // ms to wait for the response, 0 if the command has no response
+};
+
+/* Message descriptor table
+		Adding a command is one entry here, plus a decoder function if the response carries data
+*/
+constexpr MessageInfo messageTable[] =
+{
+//    cmd   req  resp  modes                                 decoder               timeout
+    { 'A',   0,   17,  MODE_APPLICATION,                     DECODE_STATUS,         300 },  // Get Status
+    { 'C',   1,   -1,  MODE_APPLICATION,                     DECODE_NONE,             0 },  // CCDump enable
+    { 'L',   0,  100,  MODE_APPLICATION,                     DECODE_LCD,            300 },  // Get LCD
+    { 'P',   0,    2,  MODE_APPLICATION,                     DECODE_POWER_STATUS,   300 },  // Get Power Status
+    { 'V',  -1,   14,  MODE_APPLICATION | MODE_BOOTLOADER,   DECODE_VERSION,        500 },  // Version, no selector byte in bootloader
+    { 'p',   0,   -1,  MODE_APPLICATION,                     DECODE_NONE,             0 },  // Clear Password
+    { 't',  18,   -1,  MODE_APPLICATION,                     DECODE_NONE,             0 },  // Set Date and Time
+};
+
+const int messageTableSize = sizeof(messageTable) / sizeof(messageTable[0]);
+
+/* Command byte to descriptor index, built by the compiler from the descriptor table
+*/
+struct MessageIndex {
+    qint8 entry[256];
+};
+
+constexpr MessageIndex makeMessageIndex()
+{
+    MessageIndex index = {};
+    for(int i = 0; i < 256; i++)
+        index.entry[i] = -1;
+    for(int i = 0; i < messageTableSize; i++)
+        index.entry[static_cast<quint8>(messageTable[i].command)] = static_cast<qint8>(i);
+    return index;
+}
+
+constexpr MessageIndex messageIndex = makeMessageIndex();
+
+/* findMessage - return the descriptor of a command or response code, nullptr if unknown
+*/
+constexpr const MessageInfo *findMessage(char command)
+{
+    return (messageIndex.entry[static_cast<quint8>(command)] < 0) ? nullptr : &messageTable[messageIndex.entry[static_cast<quint8>(command)]];
+}
+/* responseLength - return the known response length of a response code, -1 if ended by ETX
+*/
+constexpr int responseLength(char command)
+{
+    return (findMessage(command) == nullptr) ? -1 : findMessage(command)->responseLength;
+}
+/* expectsResponse - check if a command is answered with a response packet
+*/
+constexpr bool expectsResponse(char command)
+{
+    return (findMessage(command) != nullptr) && (findMessage(command)->timeout != 0);
+}
+/* requestLength - return the payload length of a command, -1 if it depends on the mode or is unknown
+*/
+constexpr int requestLength(char command)
+{
+    return (findMessage(command) == nullptr) ? -1 : findMessage(command)->requestLength;
+}
+
+} // namespace GREProtocol
+
+#endif // GREPROTOCOL_H
@@ -0,0 +1,53 @@
+/* greringbuffer.h - A simple fixed capacity receive ring buffer class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRERINGBUFFER_H
+#define GRERINGBUFFER_H
+
+#include <QtGlobal>
+
+class GRERingBuffer
+{
+public:
+    explicit GRERingBuffer(int capacity = 4096);
+    ~GRERingBuffer();
+    int getCapacity() const { return bufferSize; }
+    int getSize() const { return used; }
+    int getFree() const { return bufferSize - used; }
+    char *writeSpan(int &length);
+    void commit(int length);
+    const char *readSpan(int &length) const;
+    void consume(int length);
+    void clear();
+    quint64 getTotalBytes() const { return totalBytes; }
+    quint32 getAllocations() const { return allocations; }
+
+private:
+    Q_DISABLE_COPY(GRERingBuffer)
+    char *buffer;
+    int bufferSize;     // always a power of two
+    int head;           // next byte to read
+    int tail;           // next byte to write
+    int used;
+    quint64 totalBytes;
+    quint32 allocations;
+};
+
+#endif // GRERINGBUFFER_H
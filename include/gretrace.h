@@ -0,0 +1,82 @@
+/* gretrace.h - A bounded raw protocol trace class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRETRACE_H
+#define GRETRACE_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QElapsedTimer>
+
+/* GRETrace keeps the most recent protocol events as raw bytes. Recording is a copy into a fixed
+		buffer, the hex and text of an entry are only built when the trace is shown.
+*/
+class GRETrace
+{
+public:
+    // What to record, set from the protocol trace setting
+    enum Filter {
+        FILTER_ERRORS = 0x01,       // damaged frames, request timeouts, NAK and CAN
+        FILTER_CONTROL = 0x02,      // all control bytes
+        FILTER_FRAMES = 0x04,       // complete frames sent and received
+        FILTER_BYTES = 0x08         // every byte sent and received
+    };
+    enum Kind {
+        TRACE_TX_BYTES = 0,
+        TRACE_RX_BYTES,
+        TRACE_TX_FRAME,
+        TRACE_RX_FRAME,
+        TRACE_TX_CONTROL,
+        TRACE_RX_CONTROL,
+        TRACE_DAMAGED_FRAME,
+        TRACE_TIMEOUT
+    };
+
+    explicit GRETrace(int capacity = 1024 * 1024);
+    ~GRETrace();
+    void record(Kind kind, const char *data, int length);
+    void clear();
+    int getEntryCount() const;
+    quint64 getRecordedCount() const { return entryCount; }
+    Kind getEntryKind(int index) const;
+    QString formatEntry(int index) const;
+
+private:
+    Q_DISABLE_COPY(GRETrace)
+    enum {
+        MAX_ENTRIES = 8192          // power of two
+    };
+    struct Entry {
+        quint64 position;           // of the first data byte in the stream of recorded bytes
+        qint64 msecs;
+        int length;
+        Kind kind;
+    };
+    const Entry &entry(int index) const;
+    void copyData(const Entry &item, char *data) const;
+    char *buffer;
+    int bufferSize;                 // always a power of two
+    quint64 writePosition;          // total bytes recorded
+    Entry *entries;
+    quint64 entryCount;             // total entries recorded
+    QElapsedTimer clock;
+};
+
+#endif // GRETRACE_H
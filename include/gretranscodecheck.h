@@ -0,0 +1,61 @@
+/* gretranscodecheck.h - Checks every firmware image against every supported transcode
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef GRETRANSCODECHECK_H
+#define GRETRANSCODECHECK_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/* GRETranscodeCheck transcodes firmware images to every target platform supported for them
+		on the global thread pool, before any scanner is connected. Each result says if the
+		transcode is refused, if the streaming and batch transcodes agree, and if transcoding
+		back gives the original image apart from the version fixups.
+*/
+class GRETranscodeCheck
+{
+public:
+    enum Status {
+        STATUS_OK = 0,
+        STATUS_NO_ROUND_TRIP,       // transcode ok, there is no transcode back to check
+        STATUS_LOAD_ERROR,          // not a valid firmware file or archive
+        STATUS_UNSUPPORTED,         // version not in the patch table or a fixup outside the image
+        STATUS_STREAM_MISMATCH,     // streaming and batch transcode produce different packets
+        STATUS_ROUND_TRIP_UNSUPPORTED,  // the transcoded image is refused by the transcode back
+        STATUS_ROUND_TRIP_MISMATCH  // transcoding back changes bytes that are not fixups
+    };
+    struct Result {
+        QString fileName;
+        quint8 platform;
+        quint8 version;
+        quint8 target;
+        Status status;
+        int patchedBytes;           // bytes changed by the round trip, all at fixup offsets
+    };
+
+    static QVector<Result> run(const QStringList &fileNames);
+    static bool isFailure(Status status) { return status >= STATUS_LOAD_ERROR; }
+    static QString statusName(Status status);
+    static QString formatResult(const Result &result);
+};
+
+#endif // GRETRANSCODECHECK_H
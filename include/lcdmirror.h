@@ -0,0 +1,62 @@
+/* lcdmirror.h - A scanner LCD mirror widget class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#ifndef LCDMIRROR_H
+#define LCDMIRROR_H
+
+#include <QWidget>
+
+#include "greparser.h"
+#include "grelcdmirror.h"
+
+class LCDMirror : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LCDMirror(QWidget *parent = 0);
+    QSize sizeHint() const override;
+
+signals:
+    void closed();
+
+public slots:
+    void updateFrame(const GREParser::GetLCDVal &frame, const GRELCDMirror::Changes &changes);
+    void setFrameRate(double fps);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void closeEvent(QCloseEvent *event) override;
+
+private:
+    enum {
+        COLUMNS = 16,                                       // LCD characters per row
+        ROWS = (GREParser::LCD_SIZE + COLUMNS - 1) / COLUMNS,
+        ICON_COUNT = GREParser::LCD_ICON_SIZE * 8,
+        MARGIN = 6
+    };
+    QRect cellRect(int index) const;
+    QRect iconRect(int index) const;
+    GREParser::GetLCDVal frame;
+    int cellWidth;
+    int cellHeight;
+};
+
+#endif // LCDMIRROR_H
@@ -27,8 +27,12 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 
 #include <QtSerialPort/QSerialPort>
 #include <QTimer>
+#include <QFuture>
+#include <QFutureWatcher>
 
 #include "greparser.h"
+#include "gretrace.h"
+#include "gretranscodecheck.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -43,7 +47,15 @@ class SettingsDialog;
 class QProgressDialog;
 class WebDownloader;
 class GREFirmware;
+class GREFirmwareCache;
+class GREFirmwareCatalogue;
 class GREParser;
+class GRERingBuffer;
+class GRECapture;
+class GRECaptureReplay;
+class GRECCDump;
+class GRELCDMirror;
+class LCDMirror;
 
 class MainWindow : public QMainWindow
 {
@@ -75,13 +87,46 @@ private slots:
     void processCpuUpdateMode(void );
     void processPowerStatus(const bool &data);
     void processVersion(const GREParser::VersionVal &data );
-    void processCCDump(const QString &data);
+    void processCCDump(const QString &line, quint64 lineCount);
+    void processCCDumpFailed();
+    void processRequestTimeout(char command);
+    void processReady(bool bootloader, qint64 msecs);
 
     void handleSerialError(QSerialPort::SerialPortError error);
     void handleApplySettings();
+    void toggleCapture(bool enable);
+    void replayCapture();
+    void processReplayTx(const QByteArray &data);
+    void processReplayRx(const QByteArray &data);
+    void processReplayFinished();
+    void showLatency();
+    void showLinkStats();
+    void showTrace();
+    void checkTranscodes();
+    void processTranscodeCheck();
+    void processFrame(const QByteArray &frame);
+    void processFrameError(const QByteArray &frame);
+    void toggleCCDumpStream(bool enable);
+    void toggleLCDMirror(bool enable);
+    void processLCDRate(double fps);
+    void processLCDMirrorClosed();
 
 private:
-    void displayProtocol(const QByteArray &data, bool txFlag);
+    void traceTx(const QByteArray &data);
+    void sendUpdatePacket();
+    void scanFirmware();
+    void prefetchFirmware();
+    // Control bytes are traced with the control filter, NAK and CAN also with the error filter,
+    // unless every byte is already traced as received
+    void traceControl(char c)
+    {
+        if(traceFilter & GRETrace::FILTER_BYTES)
+            return;
+        if((traceFilter & GRETrace::FILTER_CONTROL) ||
+                ((traceFilter & GRETrace::FILTER_ERRORS) && ((c == GREProtocol::NAK) || (c == GREProtocol::CAN))))
+            trace->record(GRETrace::TRACE_RX_CONTROL, &c, 1);
+    }
+    void saveLatency();
     void scannerTypeConfig();
 
 private:
@@ -111,6 +156,10 @@ private:
     GREParser *parser;
     WebDownloader *downloader;
     GREFirmware *firmware;
+    GREFirmwareCache *firmwareCache;
+    GREFirmwareCatalogue *catalogue;
+    QFuture<void> prefetch;         // decoding and preparing the latest firmware while connecting
+    QFutureWatcher<QVector<GRETranscodeCheck::Result> > transcodeCheck;
     Display *display;
     SettingsDialog *settings;
     QProgressDialog *progress;
@@ -126,8 +175,22 @@ private:
     QString cpuReleaseName;
     QString cpu2ReleaseName;
 
+    enum { RX_BUFFER_SIZE = 4096 };
+    enum { TRACE_BUFFER_SIZE = 1048576, TRACE_SHOW_ENTRIES = 300 };
+
     QSerialPort *serial;
+    GRERingBuffer *rxBuffer;
+    GRECapture *capture;
+    GRECaptureReplay *replay;
+    GRECCDump *ccDump;
+    GRETrace *trace;
+    int traceFilter;                // cached GRETrace::Filter flags of the protocol trace setting
+    GRELCDMirror *lcdMirror;
+    LCDMirror *lcdWindow;
+    quint64 rxBytesAtConnect;
+    quint32 rxAllocationsAtConnect;
     QByteArray updatePacket;
+    bool updateFramed;              // updatePacket is a frame from the pre-encoded packet table
     int nakCount;
     QTimer *commsTimer;
     QTimer *dlTimer;
@@ -61,7 +61,8 @@ public:
         QString stringStopBits;
         QSerialPort::FlowControl flowControl;
         QString stringFlowControl;
-        bool protocolDebugEnabled;
+        int protocolTrace;          // GRETrace::Filter flags
+        bool preEncodePackets;      // frame the whole firmware image before the update starts
     };
 
     explicit SettingsDialog(QWidget *parent = 0);
@@ -0,0 +1,385 @@
+/* gre7zarchive.cpp - A minimal reader for single file 7z firmware archives
+        Only what the bundled firmware archives use is supported: an unencoded header and one
+        folder with a single LZMA or LZMA2 coder. Decoding is done by liblzma.
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/gre7zarchive.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <lzma.h>
+
+// 7z header property ids
+enum PropertyId {
+    ID_END = 0x00,
+    ID_HEADER = 0x01,
+    ID_MAIN_STREAMS_INFO = 0x04,
+    ID_FILES_INFO = 0x05,
+    ID_PACK_INFO = 0x06,
+    ID_UNPACK_INFO = 0x07,
+    ID_SUBSTREAMS_INFO = 0x08,
+    ID_SIZE = 0x09,
+    ID_CRC = 0x0a,
+    ID_FOLDER = 0x0b,
+    ID_CODERS_UNPACK_SIZE = 0x0c,
+    ID_NUM_UNPACK_STREAM = 0x0d,
+    ID_NAME = 0x11
+};
+
+// Supported coders
+static const quint64 coderLZMA = 0x030101;
+static const quint64 coderLZMA2 = 0x21;
+
+static const quint8 signature[6] = { '7', 'z', 0xbc, 0xaf, 0x27, 0x1c };
+
+/* readNumber - read a 7z variable length number, the count of leading one bits of the first byte
+		is the number of extra little endian bytes
+*/
+static bool readNumber(const quint8 *&p, const quint8 *end, quint64 &value)
+{
+    quint8 first;
+    quint8 mask = 0x80;
+    if(p >= end)
+        return false;
+    first = *p++;
+    value = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        if((first & mask) == 0)
+        {
+            value |= static_cast<quint64>(first & (mask - 1)) << (8 * i);
+            return true;
+        }
+        if(p >= end)
+            return false;
+        value |= static_cast<quint64>(*p++) << (8 * i);
+        mask >>= 1;
+    }
+    return true;
+}
+/* readDigests - read the CRCs of count items, returns the first one if it is defined
+*/
+static bool readDigests(const quint8 *&p, const quint8 *end, quint64 count, bool &defined, quint32 &crc)
+{
+    quint64 definedCount = 0;
+    bool first = false;
+    if(p >= end)
+        return false;
+    if(*p++ != 0)   // all defined
+    {
+        definedCount = count;
+        first = (count > 0);
+    }
+    else
+    {
+        if(static_cast<quint64>(end - p) < ((count + 7) >> 3))
+            return false;
+        for(quint64 i = 0; i < count; i++)
+        {
+            if((p[i >> 3] >> (7 - (i & 7))) & 1)
+            {
+                definedCount++;
+                if(i == 0)
+                    first = true;
+            }
+        }
+        p += (count + 7) >> 3;
+    }
+    if((end - p) < static_cast<qint64>(4 * definedCount))
+        return false;
+    defined = first;
+    if(first)
+        crc = qFromLittleEndian<quint32>(p);
+    p += 4 * definedCount;
+    return true;
+}
+/* Constructor
+*/
+GRE7zArchive::GRE7zArchive()
+    : packOffset(0),
+      packSize(0),
+      unpackSize(0),
+      coder(0),
+      crcDefined(false),
+      crc(0)
+{
+
+}
+/* Destructor
+*/
+GRE7zArchive::~GRE7zArchive()
+{
+
+}
+/* isArchiveName - check if a file name is a 7z archive
+*/
+bool GRE7zArchive::isArchiveName(const QString &fileName)
+{
+    return fileName.endsWith(QLatin1String(".7z"), Qt::CaseInsensitive);
+}
+/* open - check the archive and read where the packed file is and how it is coded
+		A reference to the archive bytes is kept, so a view of a mapped file works without a copy
+*/
+bool GRE7zArchive::open(const QByteArray &archive)
+{
+    const quint8 *start = reinterpret_cast<const quint8 *>(archive.constData());
+    quint64 nextHeaderOffset;
+    quint64 nextHeaderSize;
+    archiveData.clear();
+    name.clear();
+    errorString.clear();
+    if(archive.size() < SIGNATURE_HEADER_SIZE)
+        return setError(QString("not a 7z archive"));
+    if(memcmp(start, signature, sizeof(signature)) != 0)
+        return setError(QString("not a 7z archive"));
+    if(lzma_crc32(start + 12, 20, 0) != qFromLittleEndian<quint32>(start + 8))
+        return setError(QString("the 7z signature header is damaged"));
+    nextHeaderOffset = qFromLittleEndian<quint64>(start + 12);
+    nextHeaderSize = qFromLittleEndian<quint64>(start + 20);
+    if((nextHeaderOffset > static_cast<quint64>(archive.size() - SIGNATURE_HEADER_SIZE)) ||
+            (nextHeaderSize > static_cast<quint64>(archive.size() - SIGNATURE_HEADER_SIZE) - nextHeaderOffset))
+        return setError(QString("the 7z header is outside the archive"));
+    const quint8 *header = start + SIGNATURE_HEADER_SIZE + nextHeaderOffset;
+    if(lzma_crc32(header, nextHeaderSize, 0) != qFromLittleEndian<quint32>(start + 28))
+        return setError(QString("the 7z header is damaged"));
+    if(!readHeader(header, header + nextHeaderSize))
+        return errorString.isEmpty() ? setError(QString("the 7z archive is not a single LZMA compressed file")) : false;
+    // the sizes are untrusted 64 bit numbers, check them without overflow
+    if((packSize > static_cast<quint64>(archive.size() - SIGNATURE_HEADER_SIZE)) ||
+            (packOffset > static_cast<quint64>(archive.size() - SIGNATURE_HEADER_SIZE) - packSize))
+        return setError(QString("the packed data is outside the 7z archive"));
+    archiveData = archive;
+    return true;
+}
+/* setError - remember why the archive could not be read, always returns false
+*/
+bool GRE7zArchive::setError(const QString &message) const
+{
+    errorString = message;
+    return false;
+}
+/* readHeader - parse the unencoded 7z header of a single folder, single coder archive
+*/
+bool GRE7zArchive::readHeader(const quint8 *p, const quint8 *end)
+{
+    quint64 value;
+    quint64 count;
+    if((p >= end) || (*p++ != ID_HEADER))
+        return false;   // encoded headers are not supported
+    if((p >= end) || (*p++ != ID_MAIN_STREAMS_INFO))
+        return false;
+    // Pack info: position and size of the packed stream
+    if((p >= end) || (*p++ != ID_PACK_INFO))
+        return false;
+    if(!readNumber(p, end, value) || !readNumber(p, end, count) || (count != 1))
+        return false;
+    packOffset = value;
+    packSize = 0;
+    while((p < end) && (*p != ID_END))
+    {
+        quint8 id = *p++;
+        if(id == ID_SIZE)
+        {
+            if(!readNumber(p, end, value))
+                return false;
+            packSize = value;
+        }
+        else if(id == ID_CRC)
+        {
+            bool defined;
+            quint32 packCrc;
+            if(!readDigests(p, end, count, defined, packCrc))
+                return false;
+        }
+        else
+            return false;
+    }
+    p++;
+    // Unpack info: one folder with one simple coder
+    if((p >= end) || (*p++ != ID_UNPACK_INFO))
+        return false;
+    if((p >= end) || (*p++ != ID_FOLDER))
+        return false;
+    if(!readNumber(p, end, count) || (count != 1) || (p >= end) || (*p++ != 0))
+        return false;
+    if(!readNumber(p, end, count) || (count != 1) || (p >= end))
+        return false;
+    quint8 flags = *p++;
+    int idSize = flags & 0x0f;
+    if(((flags & 0x10) != 0) || ((end - p) < idSize))
+        return false;   // complex coders are not supported
+    coder = 0;
+    for(int i = 0; i < idSize; i++)
+        coder = (coder << 8) | *p++;
+    coderProperties.clear();
+    if(flags & 0x20)
+    {
+        if(!readNumber(p, end, value) || (static_cast<quint64>(end - p) < value))
+            return false;
+        coderProperties = QByteArray(reinterpret_cast<const char *>(p), static_cast<int>(value));
+        p += value;
+    }
+    if((p >= end) || (*p++ != ID_CODERS_UNPACK_SIZE) || !readNumber(p, end, value))
+        return false;
+    if(value > static_cast<quint64>(MAX_UNPACK_SIZE))
+        return setError(QString("the file in the 7z archive is larger than a firmware image"));
+    unpackSize = static_cast<qint64>(value);
+    crcDefined = false;
+    while((p < end) && (*p != ID_END))
+    {
+        if(*p++ != ID_CRC)
+            return false;
+        if(!readDigests(p, end, 1, crcDefined, crc))
+            return false;
+    }
+    p++;
+    // Substreams info: only a single file and its CRC
+    if((p < end) && (*p == ID_SUBSTREAMS_INFO))
+    {
+        p++;
+        while((p < end) && (*p != ID_END))
+        {
+            quint8 id = *p++;
+            if(id == ID_NUM_UNPACK_STREAM)
+            {
+                if(!readNumber(p, end, value) || (value != 1))
+                    return false;
+            }
+            else if(id == ID_CRC)
+            {
+                if(!readDigests(p, end, 1, crcDefined, crc))
+                    return false;
+            }
+            else
+                return false;
+        }
+        p++;
+    }
+    if((p >= end) || (*p++ != ID_END))
+        return false;
+    // Files info: only the name is used
+    if((p < end) && (*p == ID_FILES_INFO))
+    {
+        p++;
+        if(!readNumber(p, end, count) || (count != 1))
+            return false;
+        while((p < end) && (*p != ID_END))
+        {
+            quint8 id = *p++;
+            if(!readNumber(p, end, value) || (static_cast<quint64>(end - p) < value))
+                return false;
+            if((id == ID_NAME) && (value >= 3) && (p[0] == 0))
+            {
+                const quint8 *c = p + 1;
+                while(((c + 1) < (p + value)) && ((c[0] | c[1]) != 0))
+                {
+                    name.append(QChar(qFromLittleEndian<quint16>(c)));
+                    c += 2;
+                }
+            }
+            p += value;
+        }
+    }
+    return (coder == coderLZMA) || (coder == coderLZMA2);
+}
+/* extract - decode the first length bytes of the file, or all of it if length is -1
+		The whole file is checked against its CRC, a partial decode is only as good as the
+		bytes decoded. Decoding stops as soon as length bytes are out.
+*/
+bool GRE7zArchive::extract(QByteArray &data, qint64 length) const
+{
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_filter filters[2];
+    lzma_ret ret;
+    bool ok;
+    if(archiveData.isEmpty())
+        return setError(QString("no 7z archive is open"));
+    if((length < 0) || (length > unpackSize))
+        length = unpackSize;
+    filters[0].id = (coder == coderLZMA2) ? LZMA_FILTER_LZMA2 : LZMA_FILTER_LZMA1;
+    filters[0].options = nullptr;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    if(lzma_properties_decode(&filters[0], nullptr, reinterpret_cast<const quint8 *>(coderProperties.constData()),
+                              static_cast<size_t>(coderProperties.size())) != LZMA_OK)
+        return setError(QString("the 7z coder properties are not supported"));
+    ret = lzma_raw_decoder(&stream, filters);
+    free(filters[0].options);
+    if(ret != LZMA_OK)
+        return setError(QString("the 7z decoder could not be started"));
+    data.resize(static_cast<int>(length));
+    stream.next_in = reinterpret_cast<const quint8 *>(archiveData.constData()) + SIGNATURE_HEADER_SIZE + packOffset;
+    stream.avail_in = static_cast<size_t>(packSize);
+    stream.next_out = reinterpret_cast<quint8 *>(data.data());
+    stream.avail_out = static_cast<size_t>(length);
+    do
+        ret = lzma_code(&stream, LZMA_RUN);
+    while((ret == LZMA_OK) && (stream.avail_out != 0) && (stream.avail_in != 0));
+    ok = ((ret == LZMA_OK) || (ret == LZMA_STREAM_END)) && (stream.avail_out == 0);
+    lzma_end(&stream);
+    if(!ok)
+        setError(QString("the packed data in the 7z archive is damaged"));
+    else if((length == unpackSize) && crcDefined &&
+            (lzma_crc32(reinterpret_cast<const quint8 *>(data.constData()), static_cast<size_t>(length), 0) != crc))
+        ok = setError(QString("the file in the 7z archive fails its CRC check"));
+    if(!ok)
+        data.clear();
+    return ok;
+}
+/* readFile - decode the file in a 7z archive on disk into memory
+		The archive is mapped, nothing is written to disk. unpackSize is set to the size of
+		the whole file when only the first length bytes are decoded. errorString is set to why
+		the file could not be read.
+*/
+bool GRE7zArchive::readFile(const QString &fileName, QByteArray &data, qint64 length, qint64 *unpackSize, QString *errorString)
+{
+    QFile file(fileName);
+    GRE7zArchive archive;
+    uchar *mapped;
+    bool ok;
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        if(errorString != nullptr)
+            *errorString = file.errorString();
+        return false;
+    }
+    if(file.size() > std::numeric_limits<int>::max())
+    {
+        if(errorString != nullptr)
+            *errorString = QString("the 7z archive is too large");
+        return false;
+    }
+    mapped = file.map(0, file.size());
+    if(mapped != nullptr)
+    {
+        ok = archive.open(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), static_cast<int>(file.size()))) && archive.extract(data, length);
+        file.unmap(mapped);
+    }
+    else
+        ok = archive.open(file.readAll()) && archive.extract(data, length);
+    if(ok && (unpackSize != nullptr))
+        *unpackSize = archive.getUnpackSize();
+    if(!ok && (errorString != nullptr))
+        *errorString = archive.getErrorString();
+    return ok;
+}
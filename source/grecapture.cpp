@@ -0,0 +1,197 @@
+/* grecapture.cpp - Binary protocol capture and replay classes
+        GRECapture records every Tx and Rx chunk with a monotonic timestamp. Records are appended
+        to a memory block and written to disk by a low priority writer thread.
+        GRECaptureReplay feeds a capture back into a GREParser at recorded speed or at full speed.
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grecapture.h"
+#include "include/greparser.h"
+
+#include <QFile>
+#include <QTimer>
+#include <QtEndian>
+
+/* Constructor
+*/
+GRECapture::GRECapture(QObject *parent)
+    : QObject(parent)
+{
+    recordCount = 0;
+}
+/* Destructor
+*/
+GRECapture::~GRECapture()
+{
+    stop();
+}
+/* start - create the capture file and start writing records to it
+*/
+bool GRECapture::start(const QString &fileName)
+{
+    recordCount = 0;
+    if(!fileWriter.start(fileName, QByteArray(GRECaptureFormat::magic, GRECaptureFormat::magicSize)))
+        return false;
+    clock.start();
+    return true;
+}
+/* stop - write out the pending records and close the capture file
+*/
+void GRECapture::stop()
+{
+    fileWriter.stop();
+}
+/* record - add one Tx or Rx chunk to the capture
+		Only a memory copy is done here, the file writer thread does the file access
+*/
+void GRECapture::record(GRECaptureFormat::Direction direction, const char *data, int length)
+{
+    uchar header[GRECaptureFormat::recordHeaderSize];
+    if(!fileWriter.isStarted() || (length <= 0))
+        return;
+    qToLittleEndian<quint64>(static_cast<quint64>(clock.nsecsElapsed()), header);
+    header[8] = static_cast<uchar>(direction);
+    qToLittleEndian<quint32>(static_cast<quint32>(length), header + 9);
+    fileWriter.append(reinterpret_cast<const char *>(header), GRECaptureFormat::recordHeaderSize, data, length);
+    recordCount++;
+}
+/* Constructor
+*/
+GRECaptureReplay::GRECaptureReplay(GREParser *parser, QObject *parent)
+    : QObject(parent), parser(parser)
+{
+    position = 0;
+    active = false;
+    realTime = false;
+}
+/* Destructor
+*/
+GRECaptureReplay::~GRECaptureReplay()
+{
+
+}
+/* open - load a capture file and check the file header
+*/
+bool GRECaptureReplay::open(const QString &fileName)
+{
+    QFile file(fileName);
+    stop();
+    capture.clear();
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    capture = file.readAll();
+    file.close();
+    if(!capture.startsWith(QByteArray::fromRawData(GRECaptureFormat::magic, GRECaptureFormat::magicSize)))
+    {
+        capture.clear();
+        return false;
+    }
+    position = GRECaptureFormat::magicSize;
+    return true;
+}
+/* start - replay the capture from the beginning
+		At full speed all records are fed to the parser before returning.
+		At recorded speed a timer delivers each record at its recorded time.
+*/
+void GRECaptureReplay::start(bool recordedSpeed)
+{
+    quint64 timestamp;
+    quint8 direction;
+    QByteArray data;
+    if(capture.isEmpty())
+        return;
+    position = GRECaptureFormat::magicSize;
+    realTime = recordedSpeed;
+    active = true;
+    if(realTime)
+    {
+        clock.start();
+        replayNext();
+        return;
+    }
+    while(active && readRecord(timestamp, direction, data))
+        deliver(direction, data);
+    active = false;
+    emit finished();
+}
+/* stop - stop a replay in progress
+*/
+void GRECaptureReplay::stop()
+{
+    active = false;
+}
+/* replayNext - deliver the records that are due and wait for the next one
+*/
+void GRECaptureReplay::replayNext()
+{
+    quint64 timestamp;
+    quint8 direction;
+    QByteArray data;
+    int recordStart;
+    qint64 delay;
+    while(active)
+    {
+        recordStart = position;
+        if(!readRecord(timestamp, direction, data))
+        {
+            active = false;
+            emit finished();
+            return;
+        }
+        delay = static_cast<qint64>(timestamp / 1000000) - clock.elapsed();
+        if(delay > 0)
+        {
+            position = recordStart;
+            QTimer::singleShot(static_cast<int>(delay), this, SLOT(replayNext()));
+            return;
+        }
+        deliver(direction, data);
+    }
+}
+/* readRecord - read the next record, data is a view into the loaded capture
+*/
+bool GRECaptureReplay::readRecord(quint64 &timestamp, quint8 &direction, QByteArray &data)
+{
+    const uchar *header = reinterpret_cast<const uchar *>(capture.constData()) + position;
+    quint32 length;
+    if((capture.size() - position) < GRECaptureFormat::recordHeaderSize)
+        return false;
+    timestamp = qFromLittleEndian<quint64>(header);
+    direction = header[8];
+    length = qFromLittleEndian<quint32>(header + 9);
+    if(length > static_cast<quint32>(capture.size() - position - GRECaptureFormat::recordHeaderSize))
+        return false;   // truncated capture
+    data = QByteArray::fromRawData(capture.constData() + position + GRECaptureFormat::recordHeaderSize, length);
+    position += GRECaptureFormat::recordHeaderSize + length;
+    return true;
+}
+/* deliver - feed received data to the parser and report sent data
+*/
+void GRECaptureReplay::deliver(quint8 direction, const QByteArray &data)
+{
+    if(direction == GRECaptureFormat::DIRECTION_TX)
+    {
+        emit replayTx(data);
+    }
+    else
+    {
+        emit replayRx(data);
+        parser->receiveData(data);
+    }
+}
@@ -0,0 +1,179 @@
+/* greccdump.cpp - CCDump line decoder and file sink class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/greccdump.h"
+
+#include <QString>
+
+#include <cstring>
+
+/* isBlank - check for the white space found in CCDump lines
+*/
+static inline bool isBlank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+/* putNumber - store a decimal number and return the number of characters
+*/
+static int putNumber(char *p, quint64 value)
+{
+    char digits[20];
+    int count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while(value != 0);
+    for(int i = 0; i < count; i++)
+        p[i] = digits[count - 1 - i];
+    return count;
+}
+/* Constructor
+*/
+GRECCDump::GRECCDump(QObject *parent) : QObject(parent)
+{
+    failureReported = false;
+    reset();
+}
+/* Destructor
+*/
+GRECCDump::~GRECCDump()
+{
+    stop();
+}
+/* start - create the CCDump file and start streaming records to it
+*/
+bool GRECCDump::start(const QString &fileName)
+{
+    reset();
+    failureReported = false;
+    return fileWriter.start(fileName, QByteArray("msecs\ttag\tfields\n"));
+}
+/* stop - write out the pending records and close the CCDump file
+*/
+void GRECCDump::stop()
+{
+    fileWriter.stop();
+}
+/* reset - restart the line counts and the record clock
+*/
+void GRECCDump::reset()
+{
+    clock.start();
+    lastSample = -SAMPLE_INTERVAL;
+    lineCount = 0;
+    badLineCount = 0;
+}
+/* parseLine - split a CCDump line at the first ':' into a tag and its fields
+		Leading and trailing white space is dropped from both, the line end is not part of the record
+*/
+bool GRECCDump::parseLine(const char *line, int length, Record &record)
+{
+    const char *end = line + length;
+    const char *colon;
+    const char *p;
+    while((end != line) && isBlank(end[-1]))
+        end--;
+    while((line != end) && isBlank(*line))
+        line++;
+    colon = static_cast<const char *>(memchr(line, ':', end - line));
+    if(colon == nullptr)
+        return false;
+    for(p = colon; (p != line) && isBlank(p[-1]); p--)
+        ;
+    record.tag = line;
+    record.tagLength = static_cast<int>(p - line);
+    for(p = colon + 1; (p != end) && isBlank(*p); p++)
+        ;
+    record.fields = p;
+    record.fieldsLength = static_cast<int>(end - p);
+    return record.tagLength > 0;
+}
+/* processLine - decode one CCDump line from the parser
+		Without a file every line is displayed as it is. While streaming nothing is allocated
+		unless a line is due for display. A file that can no longer be written is reported once.
+*/
+void GRECCDump::processLine(const QByteArray &line)
+{
+    Record record;
+    qint64 now;
+    bool parsed = parseLine(line.constData(), line.size(), record);
+    if(parsed)
+        lineCount++;
+    else
+        badLineCount++;
+    if(!fileWriter.isStarted())
+    {
+        emit sample(QString::fromLatin1(line), lineCount);
+        return;
+    }
+    if(!fileWriter.isActive())
+    {
+        if(!failureReported)
+        {
+            failureReported = true;
+            emit streamFailed();
+        }
+        return;
+    }
+    if(!parsed)
+        return;
+    writeRecord(record);
+    now = clock.elapsed();
+    if((now - lastSample) >= SAMPLE_INTERVAL)
+    {
+        lastSample = now;
+        emit sample(QString::fromLatin1(record.tag, static_cast<int>(record.fields + record.fieldsLength - record.tag)), lineCount);
+    }
+}
+/* writeRecord - format a record as a tab separated file line and pass it to the file writer
+		Runs of white space between fields become one tab
+*/
+void GRECCDump::writeRecord(const Record &record)
+{
+    char *p = lineBuffer;
+    char *limit = lineBuffer + LINE_BUFFER_SIZE - 1;    // room for the line end
+    const char *end = record.fields + record.fieldsLength;
+    bool blank = false;
+    p += putNumber(p, static_cast<quint64>(clock.elapsed()));
+    *p++ = '\t';
+    int length = qMin(record.tagLength, static_cast<int>(limit - p) - 1);
+    memcpy(p, record.tag, length);
+    p += length;
+    *p++ = '\t';
+    for(const char *it = record.fields; (it != end) && (p != limit); it++)
+    {
+        if(isBlank(*it))
+        {
+            blank = true;
+            continue;
+        }
+        if(blank)
+        {
+            *p++ = '\t';
+            blank = false;
+            if(p == limit)
+                break;
+        }
+        *p++ = *it;
+    }
+    *p++ = '\n';
+    fileWriter.append(lineBuffer, static_cast<int>(p - lineBuffer));
+}
@@ -0,0 +1,187 @@
+/* grefilewriter.cpp - A batched background file writer class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grefilewriter.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+
+/* GREFileWriterThread - thread running the file writer loop
+*/
+class GREFileWriterThread : public QThread
+{
+public:
+    explicit GREFileWriterThread(GREFileWriter *fileWriter) : fileWriter(fileWriter) {}
+protected:
+    void run() override { fileWriter->writerLoop(); }
+private:
+    GREFileWriter *fileWriter;
+};
+
+/* Constructor
+*/
+GREFileWriter::GREFileWriter()
+{
+    active = false;
+    stopping = false;
+    failed = false;
+    bytesWritten = 0;
+    bytesDropped = 0;
+    writer = nullptr;
+}
+/* Destructor
+*/
+GREFileWriter::~GREFileWriter()
+{
+    stop();
+}
+/* start - create the file with its header and start the writer thread
+		The file is opened here, so a file that can not be created is reported to the caller
+*/
+bool GREFileWriter::start(const QString &name, const QByteArray &header)
+{
+    stop();
+    file.setFileName(name);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    if(file.write(header) != header.size())
+    {
+        file.close();
+        return false;
+    }
+    QMutexLocker locker(&mutex);
+    stopping = false;
+    failed = false;
+    bytesWritten = header.size();
+    bytesDropped = 0;
+    pending.reserve(FLUSH_SIZE * 2);
+    pending.resize(0);
+    active = true;
+    locker.unlock();
+    writer = new GREFileWriterThread(this);
+    writer->start(QThread::LowPriority);
+    return true;
+}
+/* stop - write out the pending data and stop the writer thread
+*/
+void GREFileWriter::stop()
+{
+    if(writer == nullptr)
+        return;
+    mutex.lock();
+    active = false;
+    stopping = true;
+    pendingReady.wakeOne();
+    mutex.unlock();
+    writer->wait();
+    delete writer;
+    writer = nullptr;
+    file.close();
+}
+/* isActive - check if appended data is accepted, false once stopped or the file could not be written
+*/
+bool GREFileWriter::isActive() const
+{
+    QMutexLocker locker(&mutex);
+    return active;
+}
+/* hasFailed - check if the file could not be written since start
+*/
+bool GREFileWriter::hasFailed() const
+{
+    QMutexLocker locker(&mutex);
+    return failed;
+}
+/* getBytesWritten - return the bytes written to the file, header included
+*/
+quint64 GREFileWriter::getBytesWritten() const
+{
+    QMutexLocker locker(&mutex);
+    return bytesWritten;
+}
+/* getBytesDropped - return the bytes dropped because the writer fell behind or failed
+*/
+quint64 GREFileWriter::getBytesDropped() const
+{
+    QMutexLocker locker(&mutex);
+    return bytesDropped;
+}
+/* append - add data for the writer thread
+		Only a memory copy is done here, the writer thread does the file access
+*/
+void GREFileWriter::append(const char *data, int length)
+{
+    append(nullptr, 0, data, length);
+}
+/* append - add a record prefix and its data as one unit
+*/
+void GREFileWriter::append(const char *prefix, int prefixLength, const char *data, int length)
+{
+    QMutexLocker locker(&mutex);
+    if(!active)
+        return;
+    if(pending.size() + prefixLength + length > MAX_PENDING)
+    {
+        bytesDropped += prefixLength + length;
+        return;
+    }
+    if(prefixLength > 0)
+        pending.append(prefix, prefixLength);
+    if(length > 0)
+        pending.append(data, length);
+    if(pending.size() >= FLUSH_SIZE)
+        pendingReady.wakeOne();
+}
+/* writerLoop - write pending data to the file until stopped
+		The pending block is swapped with an empty one so appending is never blocked by the disk.
+		After a write error nothing more is accepted and the rest is counted as dropped.
+*/
+void GREFileWriter::writerLoop()
+{
+    QByteArray block;
+    qint64 written;
+    bool writing;
+    block.reserve(FLUSH_SIZE * 2);
+    mutex.lock();
+    while(!stopping || !pending.isEmpty())
+    {
+        if(!stopping && (pending.size() < FLUSH_SIZE))
+            pendingReady.wait(&mutex, FLUSH_INTERVAL);
+        if(pending.isEmpty())
+            continue;
+        block.swap(pending);
+        writing = !failed;
+        mutex.unlock();
+        written = writing ? file.write(block) : 0;
+        mutex.lock();
+        if(written > 0)
+            bytesWritten += written;
+        if(written != block.size())
+        {
+            bytesDropped += block.size() - qMax<qint64>(written, 0);
+            failed = true;
+            active = false;
+        }
+        block.resize(0);
+    }
+    mutex.unlock();
+    file.flush();
+}
@@ -21,14 +21,25 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 	
 */
 #include "include/grefirmware.h"
+#include "include/greprotocol.h"
+#include "include/gre7zarchive.h"
 
-#include <QFileDialog>
+#include <QFile>
+
+#include <lzma.h>
+
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* Transcode tables
 */
 const int transcodeTableSize = 256;
 
-static quint8 ws1080Pro668Table[transcodeTableSize] =
+alignas(32) static const quint8 ws1080Pro668Table[transcodeTableSize] =
 {
     0x08, 0x40, 0x08, 0x40, 0x08, 0x40, 0x89, 0x48, 0x89, 0x48, 0x89, 0x48, 0x89, 0x48, 0x08, 0x40,
     0x08, 0x40, 0x08, 0x40, 0x08, 0x40, 0xF7, 0xDF, 0xF7, 0xDF, 0xF7, 0xDF, 0xF7, 0xDF, 0x99, 0xC8,
@@ -49,7 +60,7 @@ static quint8 ws1080Pro668Table[transcodeTableSize] =
 
 };
 
-static quint8 ws1080PSR800Table[transcodeTableSize] =
+alignas(32) static const quint8 ws1080PSR800Table[transcodeTableSize] =
 {
     0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB,
     0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0xA7, 0xDB, 0x5A, 0xF5,
@@ -68,7 +79,7 @@ static quint8 ws1080PSR800Table[transcodeTableSize] =
     0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D,
     0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xCB, 0x7D, 0xA7, 0xDB,
 };
-static quint8 ws1080Pro18Table[transcodeTableSize] =
+alignas(32) static const quint8 ws1080Pro18Table[transcodeTableSize] =
 {
     0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA,
     0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0xB5, 0xEA, 0x6C, 0xA6,
@@ -89,7 +100,7 @@ static quint8 ws1080Pro18Table[transcodeTableSize] =
 
 };
 
-static struct patchInfo
+static const struct patchInfo
 {
     qint32 vOffset;
     quint8 vXor;
@@ -111,138 +122,500 @@ static struct patchInfo
 { 0, 0, 0, 0, 0 }
 };
 
-static struct
+/* xorKernel - XOR data with a repeating 256 byte key, phase is the key index of the first byte
+		There is one instance per key table so the key address and alignment are compile time
+		constants. The bytes up to the next key period are done one at a time, then whole key
+		periods with the widest vectors the build targets, then the tail one at a time.
+*/
+template<const quint8 *key>
+static void xorKernel(char *data, int length, int phase)
+{
+    int i = 0;
+    phase &= transcodeTableSize - 1;
+    while((((phase + i) & (transcodeTableSize - 1)) != 0) && (i < length))
+    {
+        data[i] ^= key[(phase + i) & (transcodeTableSize - 1)];
+        i++;
+    }
+    for(; (i + transcodeTableSize) <= length; i += transcodeTableSize)
+    {
+        char *block = data + i;
+#if defined(__AVX2__)
+        for(int j = 0; j < transcodeTableSize; j += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + j));
+            v = _mm256_xor_si256(v, _mm256_load_si256(reinterpret_cast<const __m256i *>(key + j)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(block + j), v);
+        }
+#elif defined(__SSE2__)
+        for(int j = 0; j < transcodeTableSize; j += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + j));
+            v = _mm_xor_si128(v, _mm_load_si128(reinterpret_cast<const __m128i *>(key + j)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(block + j), v);
+        }
+#else
+        for(int j = 0; j < transcodeTableSize; j += 8)
+        {
+            quint64 v;
+            quint64 k;
+            memcpy(&v, block + j, 8);
+            memcpy(&k, key + j, 8);
+            v ^= k;
+            memcpy(block + j, &v, 8);
+        }
+#endif
+    }
+    for(; i < length; i++)
+        data[i] ^= key[(phase + i) & (transcodeTableSize - 1)];
+}
+
+typedef void (*TranscodeKernel)(char *data, int length, int phase);
+
+static const struct
 {
     quint8 platformOld;
     quint8 platformNew;
-    quint8 *xorTable;
-    struct patchInfo *patchTable;
+    TranscodeKernel kernel;
+    const struct patchInfo *patchTable;
 } transcodeTable[] =
 {
-{ 0xE4, 0xE6, ws1080Pro668Table, nullptr },
-{ 0xE6, 0xE4, ws1080Pro668Table, ws1080PatchTable  },
-{ 0xE6, 0xEC, ws1080Pro18Table, ws1080PatchTable  },
-{ 0xE6, 0xEE, ws1080PSR800Table, ws1080PatchTable  },
-{ 0xEC, 0xE6, ws1080Pro18Table, nullptr },
-{ 0xEE, 0xE6, ws1080PSR800Table, nullptr },
+{ 0xE4, 0xE6, xorKernel<ws1080Pro668Table>, nullptr },
+{ 0xE6, 0xE4, xorKernel<ws1080Pro668Table>, ws1080PatchTable  },
+{ 0xE6, 0xEC, xorKernel<ws1080Pro18Table>, ws1080PatchTable  },
+{ 0xE6, 0xEE, xorKernel<ws1080PSR800Table>, ws1080PatchTable  },
+{ 0xEC, 0xE6, xorKernel<ws1080Pro18Table>, nullptr },
+{ 0xEE, 0xE6, xorKernel<ws1080PSR800Table>, nullptr },
 { 0, 0, nullptr, nullptr }
 };
+/* findTranscode - return the transcode table entry for a platform pair, -1 if not supported
+*/
+static int findTranscode(quint8 oldPlatform, quint8 newPlatform)
+{
+    for(int i = 0; transcodeTable[i].kernel != nullptr; i++ )
+    {
+        if((transcodeTable[i].platformOld == oldPlatform) && (transcodeTable[i].platformNew == newPlatform))
+            return i;
+    }
+    return -1;
+}
+/* findPatch - find the version patch entry for an image in a patch table
+		Returns false if the image version can not be transcoded or a fixup is outside the image,
+		patch is the entry with the fixups to apply or nullptr if the image needs none.
+*/
+static bool findPatch(const struct patchInfo *pPatch, const char *data, qint32 size, const struct patchInfo *&patch)
+{
+    unsigned char uc;
+    patch = nullptr;
+    if(pPatch == nullptr)
+        return true;
+    while(pPatch->vOffset != 0)
+    {
+        if(pPatch->vOffset >= size)
+            return false;
+        uc = data[pPatch->vOffset] ^ pPatch->vXor;
+        // Assume entry with no patch data is the last version not needing fixing
+        if((uc <= pPatch->vData) && (pPatch->patches[0].offset == 0))
+            return true;
+        if(uc == pPatch->vData)
+        {
+            for(int i = 0; (i < 4) && (pPatch->patches[i].data != 0); i++)
+            {
+                if(pPatch->patches[i].offset >= size)
+                    return false;
+            }
+            patch = pPatch;
+            return true;
+        }
+        pPatch++;
+    }
+    return false;
+}
 /* Constructor
 */
 GREFirmware::GREFirmware(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      mappedBytes(nullptr),
+      offset(0),
+      streamEntry(-1),
+      streamPatchCount(0)
 {
-
+    header.platform = 0;
+    header.dataPlatform = 0;
+    header.imageSize = 0;
 }
 /* Destructor
 */
 GREFirmware::~GREFirmware()
 {
-
+    close();
 }
-/* openFile - Open a firmware file on disk and load it
+/* load - load a firmware file without copying it
+		The file is mapped read only and the image is a view of the mapping. If the file can not
+		be mapped it is read into memory instead. A 7z archive is decoded into memory.
+		On failure getErrorString tells why.
 */
-bool GREFirmware::openFile(QString path)
+bool GREFirmware::load(const QString &fileName)
 {
-	// Display dialog to get firmware binary file
-    QString fileName = QFileDialog::getOpenFileName(nullptr, tr("Open Firmware Image"), path, tr("Firmware Files (*.BIN)"));
-    if(!fileName.isEmpty())
+    qint64 size;
+    close();
+    // a 7z archive is decoded into memory
+    if(GRE7zArchive::isArchiveName(fileName))
+    {
+        QByteArray file;
+        return GRE7zArchive::readFile(fileName, file, -1, nullptr, &errorString) && loadBuffer(file);
+    }
+    imageFile.setFileName(fileName);
+    if(!imageFile.open(QIODevice::ReadOnly))
+    {
+        errorString = imageFile.errorString();
+        return false;
+    }
+    size = imageFile.size();
+    mappedBytes = imageFile.map(0, size);
+    if(mappedBytes != nullptr)
     {
-        quint8 headerBytes[4];
-        QFileInfo fileInfo(fileName);
-        if(fileInfo.isFile() && fileInfo.isReadable())
+        if(!parseHeader(reinterpret_cast<const char *>(mappedBytes), size))
         {
-            QFile imageFile(fileName);
-            if (!imageFile.open(QIODevice::ReadOnly))
-                return false;
-            pathInfo = fileInfo.canonicalPath();
-			// Clear and read header info
-            header.platform = 0;
-            header.imageSize = 0;
-            imageData.clear();
-            if(imageFile.read(reinterpret_cast<char *>(&headerBytes), 4) != 4)
-            {
-                imageFile.close();
-                return false;
-            }
-            header.platform = headerBytes[0];
-            header.imageSize = (headerBytes[1] << 16) | (headerBytes[2] << 8) | headerBytes[3];
-			// check if size in header matches file size
-            if(header.imageSize != (imageFile.size() - 4))
-            {
-                 imageFile.close();
-                 return false;
-            }
-			// size the container and read the file into it
-            imageData.reserve(header.imageSize);
-            imageData = imageFile.read(header.imageSize);
-            imageFile.close();
-			// check if size in header matches size in container
-            if(imageData.size() != header.imageSize)
-                return false;
-            return true;
+            close();
+            return false;
         }
+        imageData = QByteArray::fromRawData(reinterpret_cast<const char *>(mappedBytes) + HEADER_SIZE, header.imageSize);
+        return true;
     }
+    // mapping is not supported by every file system
+    sourceBuffer = imageFile.readAll();
+    imageFile.close();
+    if(loadBuffer(sourceBuffer))
+        return true;
+    close();
     return false;
 }
-/* transcode - an experimental conversion of firmware between hardware platforms
+/* loadBuffer - load a firmware image already in memory, the image is a view of the buffer
 */
-bool GREFirmware::transcode(quint8 newPlatform)
+bool GREFirmware::loadBuffer(const QByteArray &buffer)
+{
+    // keep a reference to the buffer so the view stays valid, this does not copy the bytes
+    QByteArray source = buffer;
+    if(!parseHeader(source.constData(), source.size()))
+        return false;
+    imageData = QByteArray::fromRawData(source.constData() + HEADER_SIZE, header.imageSize);
+    sourceBuffer = source;
+    return true;
+}
+/* attach - use a shared image as the firmware image of this transfer
+		Only views of the image are kept, so attaching copies nothing. The image is referenced
+		until close, so it stays valid even if the cache drops it. The transcode to the
+		target platform is applied packet by packet, the frames are already transcoded.
+*/
+bool GREFirmware::attach(const QSharedPointer<const Image> &image)
 {
-    int i;
-    QByteArray::iterator it;
-    quint8 *pXor = nullptr;
-    struct patchInfo *pPatch = nullptr;
-    quint8 oldPlatform = header.platform;
-    i = 0;
-	// If the transcoding is supported then set a pointer to the right table
-    for(i = 0; transcodeTable[i].xorTable != nullptr; i++ )
+    close();
+    if(image.isNull() || !loadBuffer(image->file))
+        return false;
+    attachedImage = image;
+    if((header.platform != image->platform) && !beginTranscode(image->platform))
     {
-        if((transcodeTable[i].platformOld == oldPlatform) && (transcodeTable[i].platformNew == newPlatform))
-        {
-            pXor = transcodeTable[i].xorTable;
-            pPatch = transcodeTable[i].patchTable;
-            break;
-        }
+        close();
+        return false;
+    }
+    frameTable = image->frames;
+    return true;
+}
+/* close - release the firmware image and the file mapping
+*/
+void GREFirmware::close()
+{
+    // the views must go before the memory they point into
+    imageData.clear();
+    sourceBuffer.clear();
+    frameTable.clear();
+    attachedImage.clear();
+    if(mappedBytes != nullptr)
+    {
+        imageFile.unmap(mappedBytes);
+        mappedBytes = nullptr;
     }
+    if(imageFile.isOpen())
+        imageFile.close();
+    header.platform = 0;
+    header.dataPlatform = 0;
+    header.imageSize = 0;
+    offset = 0;
+    streamEntry = -1;
+    streamPatchCount = 0;
+}
+/* parseHeader - check the firmware header in place
+		The first byte is the platform, then a 24 bit big endian image size that must match the file
+*/
+bool GREFirmware::parseHeader(const char *bytes, qint64 size)
+{
+    const quint8 *headerBytes = reinterpret_cast<const quint8 *>(bytes);
+    header.platform = 0;
+    header.dataPlatform = 0;
+    header.imageSize = 0;
+    errorString.clear();
+    if(size < HEADER_SIZE)
+    {
+        errorString = QString("the file is too short for a firmware header");
+        return false;
+    }
+    if(headerBytes[0] == 0)
+    {
+        errorString = QString("the firmware header has no platform");
+        return false;
+    }
+    if(((headerBytes[1] << 16) | (headerBytes[2] << 8) | headerBytes[3]) != (size - HEADER_SIZE))
+    {
+        errorString = QString("the size in the header does not match the file");
+        return false;
+    }
+    header.platform = headerBytes[0];
+    header.dataPlatform = headerBytes[0];
+    header.imageSize = (headerBytes[1] << 16) | (headerBytes[2] << 8) | headerBytes[3];
+    return true;
+}
+/* transcode - an experimental conversion of firmware between hardware platforms
+		The whole image is converted into a private copy, see beginTranscode for converting
+		each packet as it is produced instead.
+*/
+bool GREFirmware::transcode(quint8 newPlatform)
+{
+    int entry = findTranscode(header.platform, newPlatform);
+    const struct patchInfo *pPatch;
 	// Return if trancoding is not supported
-    if(pXor == nullptr)
+    if((entry < 0) || (streamEntry >= 0))
+        return false;
+    if(!findPatch(transcodeTable[entry].patchTable, imageData.constData(), imageData.size(), pPatch))
         return false;
+    frameTable.clear();
+    // The image may be a view of a read only mapping, transcode a private copy
+    imageData = QByteArray(imageData.constData(), imageData.size());
+    char *data = imageData.data();
     // Do the actual work
     if(pPatch != nullptr)
     {
-        unsigned char uc;
-        bool okFlag = false;
-        while((pPatch->vOffset != 0) && (okFlag == false) )
+        for(int i = 0; (i < 4) && (pPatch->patches[i].data != 0); i++)
+            data[pPatch->patches[i].offset] = data[pPatch->patches[i].offset] ^ pPatch->patches[i].data;
+    }
+    transcodeTable[entry].kernel(data, imageData.size(), 0);
+    header.platform = newPlatform;
+    header.dataPlatform = newPlatform;
+    return true;
+}
+/* beginTranscode - convert the firmware between hardware platforms as packets are produced
+		The version is checked now, the fixups and the XOR key are applied to each 50 byte
+		packet by getNextPacket and encodePackets. The image itself is not changed or copied.
+*/
+bool GREFirmware::beginTranscode(quint8 newPlatform)
+{
+    int entry = findTranscode(header.platform, newPlatform);
+    const struct patchInfo *pPatch;
+    if((entry < 0) || (streamEntry >= 0))
+        return false;
+    if(!findPatch(transcodeTable[entry].patchTable, imageData.constData(), imageData.size(), pPatch))
+        return false;
+    frameTable.clear();
+    streamPatchCount = 0;
+    if(pPatch != nullptr)
+    {
+        for(int i = 0; (i < 4) && (pPatch->patches[i].data != 0); i++)
         {
-            uc = imageData[pPatch->vOffset] ^ pPatch->vXor;
-            // Assume entry with no patch data is the last version not needing fixing
-            if((uc <= pPatch->vData) && (pPatch->patches[0].offset == 0))
-            {
-                okFlag = true;
-            }
-            else if(uc == pPatch->vData)
-            {
-                for(i = 0; i < 4; i++)
-                {
-                    if((uc = pPatch->patches[i].data) == 0)
-                        break;
-                    imageData[pPatch->patches[i].offset] = imageData[pPatch->patches[i].offset] ^ uc;
-                }
-                okFlag = true;
-            }
-            pPatch++;
+            streamPatches[streamPatchCount].offset = pPatch->patches[i].offset;
+            streamPatches[streamPatchCount].data = pPatch->patches[i].data;
+            streamPatchCount++;
         }
-        if(okFlag == false)
-            return false;
     }
-    i = 0;
-    for(it = imageData.begin(); it != imageData.end(); it++ )
+    streamEntry = entry;
+    header.platform = newPlatform;
+    return true;
+}
+/* getPatchOffsets - return the image offsets a transcode to newPlatform would fix up
+		Empty if there are none or the transcode is not supported
+*/
+QVector<qint32> GREFirmware::getPatchOffsets(quint8 newPlatform) const
+{
+    QVector<qint32> offsets;
+    int entry = findTranscode(header.platform, newPlatform);
+    const struct patchInfo *pPatch;
+    if((entry < 0) || !findPatch(transcodeTable[entry].patchTable, imageData.constData(), imageData.size(), pPatch) || (pPatch == nullptr))
+        return offsets;
+    for(int i = 0; (i < 4) && (pPatch->patches[i].data != 0); i++)
+        offsets.append(pPatch->patches[i].offset);
+    return offsets;
+}
+/* findVersionFormat - return the patch table that locates the version byte of a platform
+		nullptr if no transcode from the platform has one, then the version format is unknown
+*/
+static const struct patchInfo *findVersionFormat(quint8 platform)
+{
+    for(int i = 0; transcodeTable[i].kernel != nullptr; i++ )
     {
-        *it = *it ^ *(pXor + i);
-        i = (i + 1) % transcodeTableSize;
+        if((transcodeTable[i].platformOld == platform) && (transcodeTable[i].patchTable != nullptr))
+            return transcodeTable[i].patchTable;
     }
-    header.platform = newPlatform;
+    return nullptr;
+}
+/* getVersionFormat - return the image offset and XOR value of the version byte of a platform
+		Returns false if the version format of the platform is unknown
+*/
+bool GREFirmware::getVersionFormat(quint8 platform, qint32 &offset, quint8 &key)
+{
+    const struct patchInfo *pFormat = findVersionFormat(platform);
+    if(pFormat == nullptr)
+        return false;
+    offset = pFormat->vOffset;
+    key = pFormat->vXor;
+    return true;
+}
+/* getVersionReadSize - return the image bytes to read to find the version of any known platform
+*/
+qint32 GREFirmware::getVersionReadSize()
+{
+    qint32 size = 0;
+    for(int i = 0; transcodeTable[i].kernel != nullptr; i++ )
+    {
+        for(const struct patchInfo *pPatch = transcodeTable[i].patchTable; (pPatch != nullptr) && (pPatch->vOffset != 0); pPatch++)
+            size = qMax(size, pPatch->vOffset + 1);
+    }
+    return size;
+}
+/* decodeVersion - return the version of an image as major and minor nibbles
+		0 if the version format of the platform is unknown or the image is too short to hold it
+*/
+quint8 GREFirmware::decodeVersion(quint8 platform, const char *image, qint32 size)
+{
+    qint32 offset;
+    quint8 key;
+    if(!getVersionFormat(platform, offset, key) || (offset >= size))
+        return 0;
+    return static_cast<quint8>(image[offset]) ^ key;
+}
+/* formatVersion - format a decoded version as major.minor, or unknown for version 0
+*/
+QString GREFirmware::formatVersion(quint8 version)
+{
+    if(version == 0)
+        return tr("unknown");
+    return QString("%1.%2").arg(version >> 4).arg(version & 0x0f);
+}
+/* isPatchVersion - check if a version can be transcoded with a patch table, ignoring the fixup offsets
+*/
+static bool isPatchVersion(const struct patchInfo *pPatch, quint8 version)
+{
+    for(; pPatch->vOffset != 0; pPatch++)
+    {
+        if(((version <= pPatch->vData) && (pPatch->patches[0].offset == 0)) || (version == pPatch->vData))
+            return true;
+    }
+    return false;
+}
+/* preflight - check the image just before an update, so a doomed update is never started
+		Everything is checked in place on the loaded or mapped image, only the fingerprint reads
+		the whole image. Returns false with the first problem found in result.error.
+*/
+bool GREFirmware::preflight(Preflight &result) const
+{
+    qint32 versionOffset;
+    quint8 versionKey;
+    const bool versionKnown = getVersionFormat(header.dataPlatform, versionOffset, versionKey);
+    const char *data = imageData.constData();
+    qint32 size = imageData.size();
+    int entry = findTranscode(header.dataPlatform, header.platform);
+    result.error = PREFLIGHT_OK;
+    result.platform = header.platform;
+    result.version = 0;
+    result.fingerprint = 0;
+    if(size <= 0)
+        result.error = PREFLIGHT_EMPTY;
+    // the image must already be for the target or have a transcode pending
+    else if((header.dataPlatform != header.platform) && ((entry < 0) || (entry != streamEntry)))
+        result.error = PREFLIGHT_TRANSCODE;
+    // the version must be major and minor decimal nibbles, and patchable if the transcode has patches
+    else if(versionKnown && (versionOffset < size))
+    {
+        result.version = decodeVersion(header.dataPlatform, data, size);
+        if((result.version == 0) || ((result.version >> 4) > 9) || ((result.version & 0x0f) > 9))
+            result.error = PREFLIGHT_VERSION;
+        else if((entry >= 0) && (transcodeTable[entry].patchTable != nullptr) && !isPatchVersion(transcodeTable[entry].patchTable, result.version))
+            result.error = PREFLIGHT_VERSION;
+    }
+    else if(versionKnown)
+        result.error = PREFLIGHT_VERSION;
+    if(result.error != PREFLIGHT_OK)
+        return false;
+    // the fixups applied as packets are produced
+    for(int i = 0; i < streamPatchCount; i++)
+    {
+        if((streamPatches[i].offset < 0) || (streamPatches[i].offset >= size))
+            result.error = PREFLIGHT_PATCH_OFFSET;
+    }
+    // the pre-encoded packets must cover the image and start with the target platform
+    if(!frameTable.isEmpty())
+    {
+        int packets = (size + PACKET_DATA_SIZE - 1) / PACKET_DATA_SIZE;
+        int last = size - (packets - 1) * PACKET_DATA_SIZE;
+        if((frameTable.size() != (HEADER_FRAME_SIZE + (packets - 1) * DATA_FRAME_SIZE + (DATA_FRAME_SIZE - 2 * (PACKET_DATA_SIZE - last)))) ||
+                (static_cast<quint8>(frameTable.at(1)) != header.platform))
+            result.error = PREFLIGHT_FRAMES;
+    }
+    if(result.error != PREFLIGHT_OK)
+        return false;
+    result.fingerprint = lzma_crc64(reinterpret_cast<const uint8_t *>(data), size, 0);
+    result.fingerprint = lzma_crc64(&result.platform, 1, result.fingerprint);
+    return true;
+}
+/* isTranscodeSupported - check if there is a transcode between two platforms
+*/
+bool GREFirmware::isTranscodeSupported(quint8 oldPlatform, quint8 newPlatform)
+{
+    return findTranscode(oldPlatform, newPlatform) >= 0;
+}
+/* getTranscodeCount - return the number of supported platform pairs
+*/
+int GREFirmware::getTranscodeCount()
+{
+    int count = 0;
+    while(transcodeTable[count].kernel != nullptr)
+        count++;
+    return count;
+}
+/* getTranscodePair - return a supported platform pair
+*/
+bool GREFirmware::getTranscodePair(int index, quint8 &oldPlatform, quint8 &newPlatform)
+{
+    if((index < 0) || (index >= getTranscodeCount()))
+        return false;
+    oldPlatform = transcodeTable[index].platformOld;
+    newPlatform = transcodeTable[index].platformNew;
+    return true;
+}
+/* packetData - return the image data of the packet at offset
+		With a streaming transcode the data is converted into the packet window
+*/
+const char *GREFirmware::packetData(int length)
+{
+    const char *data = imageData.constData() + offset;
+    if(streamEntry < 0)
+        return data;
+    memcpy(window, data, length);
+    for(int i = 0; i < streamPatchCount; i++)
+    {
+        if((streamPatches[i].offset >= offset) && (streamPatches[i].offset < (offset + length)))
+            window[streamPatches[i].offset - offset] ^= streamPatches[i].data;
+    }
+    transcodeTable[streamEntry].kernel(window, length, offset);
+    return window;
+}
+/* transcodeData - XOR data between two platforms without the version patches
+		offset is the position of the data in the image so it can be done in pieces
+*/
+bool GREFirmware::transcodeData(quint8 oldPlatform, quint8 newPlatform, char *data, int length, qint32 offset)
+{
+    int entry = findTranscode(oldPlatform, newPlatform);
+    if(entry < 0)
+        return false;
+    transcodeTable[entry].kernel(data, length, offset);
     return true;
 }
 /* getFirstPacket - return the firmware header packet in the firmware update format
@@ -263,12 +636,116 @@ QByteArray &GREFirmware::getFirstPacket()
 */
 QByteArray &GREFirmware::getNextPacket()
 {
-    QString data;
     dataPacket.clear();
     if(offset < imageData.size())
     {
-        dataPacket = imageData.mid(offset, 50).toHex().toUpper();
-        offset += 50;
+        int length = qMin(static_cast<int>(PACKET_DATA_SIZE), imageData.size() - offset);
+        dataPacket.resize(2 * length);
+        encodeHex(packetData(length), length, dataPacket.data());
+        offset += PACKET_DATA_SIZE;
     }
     return dataPacket;
 }
+/* encodeHex - encode data as uppercase ASCII hex and return the 8 bit sum of the hex characters
+		The sum is taken in the same pass so the frame checksum needs no second pass
+*/
+quint8 GREFirmware::encodeHex(const char *data, int length, char *hex)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    unsigned int sum = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i digit = _mm_set1_epi8('0');
+    const __m128i letter = _mm_set1_epi8('A' - '0' - 10);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+    for(; (i + 16) <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i low = _mm_and_si128(v, nibble);
+        // '0' + n, plus the gap to 'A' for n above 9
+        high = _mm_add_epi8(_mm_add_epi8(high, digit), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letter));
+        low = _mm_add_epi8(_mm_add_epi8(low, digit), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letter));
+        __m128i first = _mm_unpacklo_epi8(high, low);
+        __m128i second = _mm_unpackhi_epi8(high, low);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(hex + 2 * i), first);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(hex + 2 * i + 16), second);
+        total = _mm_add_epi64(total, _mm_sad_epu8(first, zero));
+        total = _mm_add_epi64(total, _mm_sad_epu8(second, zero));
+    }
+    sum = static_cast<unsigned int>(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8)));
+#endif
+    for(; i < length; i++)
+    {
+        unsigned char uc = static_cast<unsigned char>(data[i]);
+        hex[2 * i] = hexDigits[uc >> 4];
+        hex[2 * i + 1] = hexDigits[uc & 0x0f];
+        sum += static_cast<unsigned char>(hex[2 * i]) + static_cast<unsigned char>(hex[2 * i + 1]);
+    }
+    return static_cast<quint8>(sum);
+}
+/* encodePackets - frame every packet of the image once before the transfer
+		The frames are the same bytes GREParser::sendPacket sends, so sending the next packet
+		is a view into the table. The table is dropped when the image changes.
+*/
+bool GREFirmware::encodePackets()
+{
+    int packets = (header.imageSize + PACKET_DATA_SIZE - 1) / PACKET_DATA_SIZE;
+    int last = header.imageSize - (packets - 1) * PACKET_DATA_SIZE;
+    char *frame;
+    quint8 checksum;
+    frameTable.clear();
+    if(header.imageSize <= 0)
+        return false;
+    frameTable.resize(HEADER_FRAME_SIZE + (packets - 1) * DATA_FRAME_SIZE + (DATA_FRAME_SIZE - 2 * (PACKET_DATA_SIZE - last)));
+    frame = frameTable.data();
+    // header frame from the header packet
+    getFirstPacket();
+    frame[0] = GREProtocol::STX;
+    checksum = GREProtocol::ETX;
+    for(int i = 0; i < headerPacket.size(); i++)
+    {
+        frame[i + 1] = headerPacket.at(i);
+        checksum += static_cast<quint8>(headerPacket.at(i));
+    }
+    frame[HEADER_FRAME_SIZE - 2] = GREProtocol::ETX;
+    frame[HEADER_FRAME_SIZE - 1] = static_cast<char>(checksum);
+    frame += HEADER_FRAME_SIZE;
+    // data frames, a streaming transcode is applied here so the table holds the converted image
+    for(int n = 0; n < packets; n++)
+    {
+        int length = (n == (packets - 1)) ? last : PACKET_DATA_SIZE;
+        frame[0] = GREProtocol::STX;
+        checksum = GREProtocol::ETX + encodeHex(packetData(length), length, frame + 1);
+        frame[2 * length + 1] = GREProtocol::ETX;
+        frame[2 * length + 2] = static_cast<char>(checksum);
+        frame += DATA_FRAME_SIZE;
+        offset += PACKET_DATA_SIZE;
+    }
+    offset = 0;
+    return true;
+}
+/* getFirstFrame - return the framed header packet from the packet table
+*/
+QByteArray GREFirmware::getFirstFrame()
+{
+    offset = 0;
+    if(frameTable.isEmpty())
+        return QByteArray();
+    return QByteArray::fromRawData(frameTable.constData(), HEADER_FRAME_SIZE);
+}
+/* getNextFrame - return the next framed data packet from the packet table, empty when done
+		The frame is a view of the table, valid until the image changes
+*/
+QByteArray GREFirmware::getNextFrame()
+{
+    int start;
+    if(frameTable.isEmpty() || (offset >= imageData.size()))
+        return QByteArray();
+    start = HEADER_FRAME_SIZE + (offset / PACKET_DATA_SIZE) * DATA_FRAME_SIZE;
+    offset += PACKET_DATA_SIZE;
+    return QByteArray::fromRawData(frameTable.constData() + start, qMin(DATA_FRAME_SIZE, frameTable.size() - start));
+}
@@ -0,0 +1,247 @@
+/* grefirmwarecache.cpp - A shared cache of firmware images prepared for update
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grefirmwarecache.h"
+#include "include/gre7zarchive.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <limits>
+
+/* Constructor
+*/
+GREFirmwareCache::GREFirmwareCache(QObject *parent)
+    : QObject(parent),
+      useCount(0),
+      loadCount(0),
+      hitCount(0)
+{
+
+}
+/* Destructor
+		Transfers still holding an image keep it alive after the cache is gone
+*/
+GREFirmwareCache::~GREFirmwareCache()
+{
+
+}
+/* acquire - return the image of a firmware file prepared for a target platform
+		The file is only read when its size or modification time changed since it was hashed,
+		and only loaded, transcoded and encoded when no image has the same contents, target and
+		pre-encoding. The packet table is only built if preEncode is set. Files are read and
+		images prepared without holding the lock, a second request for an image being prepared
+		waits for it instead of preparing it again.
+		Returns a null pointer and sets error on failure, errorString tells why a file could not be loaded.
+*/
+QSharedPointer<const GREFirmware::Image> GREFirmwareCache::acquire(const QString &fileName, quint8 filePlatform, quint8 platform, bool preEncode, Error &error,
+                                                                   QString *errorString)
+{
+    QFileInfo fileInfo(fileName);
+    QString path = fileInfo.canonicalFilePath();
+    QByteArray file;
+    QByteArray hash;
+    QByteArray key;
+    QString loadError;
+    QMutexLocker locker(&mutex);
+    QHash<QString, FileHash>::const_iterator known = fileHashes.constFind(path);
+    if((known != fileHashes.constEnd()) && (known->size == fileInfo.size()) && (known->modified == fileInfo.lastModified()))
+        hash = known->hash;
+    for(;;)
+    {
+        if(!hash.isEmpty())
+        {
+            key = hash;
+            key.append(static_cast<char>(platform));
+            key.append(static_cast<char>(preEncode));
+            while(preparing.contains(key))
+                prepared.wait(&mutex);
+            QHash<QByteArray, CacheEntry>::iterator cached = images.find(key);
+            if(cached != images.end())
+            {
+                if(static_cast<quint8>(cached->image->file.at(0)) != filePlatform)
+                {
+                    error = ERROR_PLATFORM;
+                    return QSharedPointer<const GREFirmware::Image>();
+                }
+                cached->lastUse = ++useCount;
+                hitCount++;
+                error = ERROR_NONE;
+                return cached->image;
+            }
+            if(!file.isEmpty())
+                break;
+        }
+        // the file is new, changed or its image was dropped, read it without the lock
+        FileHash fileHash;
+        fileHash.size = fileInfo.size();
+        fileHash.modified = fileInfo.lastModified();
+        locker.unlock();
+        bool read = readFile(fileName, file, hash, loadError);
+        locker.relock();
+        if(!read)
+        {
+            error = ERROR_LOAD;
+            if(errorString != nullptr)
+                *errorString = loadError;
+            return QSharedPointer<const GREFirmware::Image>();
+        }
+        fileHash.hash = hash;
+        fileHashes.insert(path, fileHash);
+    }
+    // Prepare the image once without the lock, the transcode goes straight into the packet table
+    preparing.insert(key);
+    locker.unlock();
+    QSharedPointer<const GREFirmware::Image> image = prepareImage(file, filePlatform, platform, preEncode, error, loadError);
+    locker.relock();
+    preparing.remove(key);
+    prepared.wakeAll();
+    if(image.isNull())
+    {
+        if(errorString != nullptr)
+            *errorString = loadError;
+        return image;
+    }
+    // Drop the least recently used image, transfers using it keep their reference
+    if(images.size() >= MAX_IMAGES)
+    {
+        QHash<QByteArray, CacheEntry>::iterator oldest = images.begin();
+        for(QHash<QByteArray, CacheEntry>::iterator it = images.begin(); it != images.end(); it++)
+        {
+            if(it->lastUse < oldest->lastUse)
+                oldest = it;
+        }
+        images.erase(oldest);
+    }
+    CacheEntry entry;
+    entry.image = image;
+    entry.lastUse = ++useCount;
+    images.insert(key, entry);
+    loadCount++;
+    return image;
+}
+/* clear - drop all cached images and file hashes
+*/
+void GREFirmwareCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    images.clear();
+    fileHashes.clear();
+}
+/* getFileHash - return the SHA-256 of a file read by acquire, empty if it has not been read
+*/
+QByteArray GREFirmwareCache::getFileHash(const QString &fileName)
+{
+    QMutexLocker locker(&mutex);
+    return fileHashes.value(QFileInfo(fileName).canonicalFilePath()).hash;
+}
+/* getImageCount - return the number of cached images
+*/
+int GREFirmwareCache::getImageCount()
+{
+    QMutexLocker locker(&mutex);
+    return images.size();
+}
+/* getLoadCount - return the number of images prepared since the cache was created
+*/
+quint32 GREFirmwareCache::getLoadCount()
+{
+    QMutexLocker locker(&mutex);
+    return loadCount;
+}
+/* getHitCount - return the number of requests answered with an image already prepared
+*/
+quint32 GREFirmwareCache::getHitCount()
+{
+    QMutexLocker locker(&mutex);
+    return hitCount;
+}
+/* readFile - read a firmware file and hash its contents
+		The bytes are copied into memory, so a cached image never depends on the file staying
+		as it is. A 7z archive is decoded into memory.
+*/
+bool GREFirmwareCache::readFile(const QString &fileName, QByteArray &file, QByteArray &hash, QString &errorString)
+{
+    file.clear();
+    if(GRE7zArchive::isArchiveName(fileName))
+    {   // the hash is of the decoded file, so an archive and the file in it share an image
+        if(!GRE7zArchive::readFile(fileName, file, -1, nullptr, &errorString))
+            return false;
+    }
+    else
+    {
+        QFile imageFile(fileName);
+        if(!imageFile.open(QIODevice::ReadOnly))
+        {
+            errorString = imageFile.errorString();
+            return false;
+        }
+        if(imageFile.size() > std::numeric_limits<int>::max())
+        {
+            errorString = QString("the file is too large for a firmware image");
+            return false;
+        }
+        file = imageFile.readAll();
+    }
+    if(file.isEmpty())
+    {
+        errorString = QString("the file is empty");
+        return false;
+    }
+    hash = QCryptographicHash::hash(file, QCryptographicHash::Sha256);
+    return true;
+}
+/* prepareImage - load, transcode and encode a firmware file for a target platform
+		Returns a null pointer and sets error on failure, errorString tells why the file could not be loaded.
+*/
+QSharedPointer<const GREFirmware::Image> GREFirmwareCache::prepareImage(const QByteArray &file, quint8 filePlatform, quint8 platform, bool preEncode,
+                                                                        Error &error, QString &errorString)
+{
+    GREFirmware firmware;
+    if(!firmware.loadBuffer(file))
+    {
+        error = ERROR_LOAD;
+        errorString = firmware.getErrorString();
+        return QSharedPointer<const GREFirmware::Image>();
+    }
+    if(firmware.getPlatform() != filePlatform)
+    {
+        error = ERROR_PLATFORM;
+        return QSharedPointer<const GREFirmware::Image>();
+    }
+    if((platform != filePlatform) && !firmware.beginTranscode(platform))
+    {
+        error = ERROR_TRANSCODE;
+        return QSharedPointer<const GREFirmware::Image>();
+    }
+    if(preEncode && !firmware.encodePackets())
+    {
+        error = ERROR_ENCODE;
+        return QSharedPointer<const GREFirmware::Image>();
+    }
+    QSharedPointer<GREFirmware::Image> image(new GREFirmware::Image);
+    image->file = file;
+    image->platform = platform;
+    image->frames = firmware.getFrameTable();
+    error = ERROR_NONE;
+    return image;
+}
@@ -0,0 +1,222 @@
+/* grefirmwarecatalogue.cpp - An index of the firmware files on disk built from their headers
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grefirmwarecatalogue.h"
+#include "include/grefirmware.h"
+#include "include/gre7zarchive.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <cstring>
+
+// Index file format
+static const char indexMagic[] = "GREFwTool firmware index 3";
+static const int indexFields = 7;
+
+/* Constructor
+*/
+GREFirmwareCatalogue::GREFirmwareCatalogue(const QString &indexFileName, QObject *parent)
+    : QObject(parent),
+      indexFileName(indexFileName),
+      modified(false),
+      headerReads(0)
+{
+
+}
+/* Destructor
+*/
+GREFirmwareCatalogue::~GREFirmwareCatalogue()
+{
+
+}
+/* loadIndex - read the index saved by an earlier session
+		Lines that can not be parsed are dropped, the files are read again on the next scan
+*/
+bool GREFirmwareCatalogue::loadIndex()
+{
+    QFile file(indexFileName);
+    entries.clear();
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    if(in.readLine() != QLatin1String(indexMagic))
+        return false;
+    while(!in.atEnd())
+    {
+        QStringList fields = in.readLine().split(QLatin1Char('\t'));
+        Entry entry;
+        bool ok[5];
+        if(fields.size() != indexFields)
+            continue;
+        entry.path = fields.at(0);
+        entry.modified = fields.at(1).toLongLong(&ok[0]);
+        entry.size = fields.at(2).toLongLong(&ok[1]);
+        entry.valid = (fields.at(3).toUInt(&ok[2]) != 0);
+        entry.platform = static_cast<quint8>(fields.at(4).toUInt(&ok[3], 16));
+        entry.version = static_cast<quint8>(fields.at(5).toUInt(&ok[4]));
+        entry.hash = QByteArray::fromHex(fields.at(6).toLatin1());
+        if(ok[0] && ok[1] && ok[2] && ok[3] && ok[4])
+            entries.append(entry);
+    }
+    rebuildPaths();
+    modified = false;
+    return true;
+}
+/* saveIndex - write the index if it changed
+*/
+bool GREFirmwareCatalogue::saveIndex()
+{
+    if(!modified)
+        return true;
+    if(indexFileName.isEmpty())
+        return false;
+    QFile file(indexFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << indexMagic << "\n";
+    foreach(const Entry &entry, entries)
+    {
+        out << entry.path << "\t" << entry.modified << "\t" << entry.size << "\t" << (entry.valid ? 1 : 0) << "\t"
+            << QString::number(entry.platform, 16).toUpper() << "\t" << entry.version << "\t"
+            << entry.hash.toHex() << "\n";
+    }
+    out.flush();
+    modified = (out.status() != QTextStream::Ok);
+    return !modified;
+}
+/* scan - bring the catalogue up to date with the firmware files in the directories
+		A file whose size and modification time match its entry is not opened, whether it is
+		valid or not. Returns true if any entry was added, changed or removed.
+*/
+bool GREFirmwareCatalogue::scan(const QStringList &directories)
+{
+    QVector<Entry> found;
+    bool changed = false;
+    foreach(const QString &directory, directories)
+    {
+        QDir dir(directory);
+        if(directory.isEmpty() || !dir.exists())
+            continue;
+        QFileInfoList files = dir.entryInfoList(QStringList() << QStringLiteral("*.bin") << QStringLiteral("*.7z"), QDir::Files | QDir::Readable, QDir::Name | QDir::IgnoreCase);
+        foreach(const QFileInfo &fileInfo, files)
+        {
+            Entry entry;
+            entry.path = fileInfo.canonicalFilePath();
+            entry.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+            entry.size = fileInfo.size();
+            int index = paths.value(entry.path, -1);
+            if((index >= 0) && (entries.at(index).modified == entry.modified) && (entries.at(index).size == entry.size))
+            {
+                found.append(entries.at(index));
+                continue;
+            }
+            changed = true;
+            entry.valid = readHeader(entry.path, entry);
+            found.append(entry);
+        }
+    }
+    if(found.size() != entries.size())
+        changed = true;
+    entries = found;
+    rebuildPaths();
+    modified = modified || changed;
+    return changed;
+}
+/* setHash - record the content hash of a catalogued file once it has been loaded
+*/
+void GREFirmwareCatalogue::setHash(const QString &path, const QByteArray &hash)
+{
+    int index = paths.value(QFileInfo(path).canonicalFilePath(), -1);
+    if((index >= 0) && (entries.at(index).hash != hash))
+    {
+        entries[index].hash = hash;
+        modified = true;
+    }
+}
+/* findLatest - return the index of the highest version firmware for a platform, -1 if there is none
+		Files with the same version are ordered by modification time, so are all the files of a
+		platform whose version format is unknown, they all have version 0
+*/
+int GREFirmwareCatalogue::findLatest(quint8 platform) const
+{
+    int latest = -1;
+    for(int i = 0; i < entries.size(); i++)
+    {
+        const Entry &entry = entries.at(i);
+        if(!entry.valid || (entry.platform != platform))
+            continue;
+        if((latest < 0) || (entry.version > entries.at(latest).version) ||
+                ((entry.version == entries.at(latest).version) && (entry.modified > entries.at(latest).modified)))
+            latest = i;
+    }
+    return latest;
+}
+/* readHeader - read the header and version byte of a firmware file in one read at the start
+		The size in the header must match the file size. For a 7z archive the start of the file
+		in it is decoded. The version is only kept for platforms with a known version format.
+*/
+bool GREFirmwareCatalogue::readHeader(const QString &path, Entry &entry)
+{
+    const qint64 readSize = GREFirmware::HEADER_SIZE + GREFirmware::getVersionReadSize();
+    QByteArray start;
+    QFile file(path);
+    qint32 imageSize;
+    qint64 fileSize = entry.size;
+    headerReads++;
+    entry.platform = 0;
+    entry.version = 0;
+    entry.hash.clear();
+    if(GRE7zArchive::isArchiveName(path))
+    {   // only the start of the file in the archive is decoded
+        if(!GRE7zArchive::readFile(path, start, readSize, &fileSize))
+            return false;
+    }
+    else
+    {
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+        start = file.read(readSize);
+    }
+    if(start.size() < GREFirmware::HEADER_SIZE)
+        return false;
+    const quint8 *bytes = reinterpret_cast<const quint8 *>(start.constData());
+    imageSize = (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    if((bytes[0] == 0) || (imageSize != (fileSize - GREFirmware::HEADER_SIZE)))
+        return false;
+    entry.platform = bytes[0];
+    entry.version = GREFirmware::decodeVersion(entry.platform, start.constData() + GREFirmware::HEADER_SIZE, start.size() - GREFirmware::HEADER_SIZE);
+    entry.hash.clear();
+    return true;
+}
+/* rebuildPaths - index the entries by path
+*/
+void GREFirmwareCatalogue::rebuildPaths()
+{
+    paths.clear();
+    for(int i = 0; i < entries.size(); i++)
+        paths.insert(entries.at(i).path, i);
+}
@@ -0,0 +1,110 @@
+/* grelatency.cpp - A low overhead log-linear latency histogram class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grelatency.h"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+/* Constructor
+*/
+GRELatencyHistogram::GRELatencyHistogram()
+{
+    reset();
+}
+/* bucketIndex - return the bucket of a value
+		Values below 2 * SUB_BUCKET_COUNT have a bucket each. Above that the value is shifted
+		down until it fits in SUB_BUCKET_COUNT..2 * SUB_BUCKET_COUNT - 1 and the shift picks the range.
+*/
+int GRELatencyHistogram::bucketIndex(quint32 value)
+{
+    if(value < (2 * SUB_BUCKET_COUNT))
+        return static_cast<int>(value);
+    int shift = (31 - qCountLeadingZeroBits(value)) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKET_COUNT + static_cast<int>(value >> shift);
+}
+/* bucketValue - return the highest value counted in a bucket
+*/
+quint32 GRELatencyHistogram::bucketValue(int index)
+{
+    if(index < (2 * SUB_BUCKET_COUNT))
+        return static_cast<quint32>(index);
+    int shift = index / SUB_BUCKET_COUNT - 1;
+    quint32 sub = static_cast<quint32>(index - shift * SUB_BUCKET_COUNT);
+    return (sub << shift) + ((1u << shift) - 1);
+}
+/* record - count one latency
+*/
+void GRELatencyHistogram::record(quint32 usecs)
+{
+    counts[bucketIndex(usecs)]++;
+    count++;
+    total += usecs;
+    if(usecs < minValue)
+        minValue = usecs;
+    if(usecs > maxValue)
+        maxValue = usecs;
+}
+/* reset - clear all counts
+*/
+void GRELatencyHistogram::reset()
+{
+    memset(counts, 0, sizeof(counts));
+    count = 0;
+    total = 0;
+    minValue = 0xffffffff;
+    maxValue = 0;
+}
+/* percentile - return the latency that percent of the recorded latencies do not exceed
+*/
+quint32 GRELatencyHistogram::percentile(double percent) const
+{
+    quint64 rank;
+    quint64 seen = 0;
+    if(count == 0)
+        return 0;
+    rank = static_cast<quint64>(percent / 100.0 * count + 0.5);
+    if(rank < 1)
+        rank = 1;
+    for(int i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += counts[i];
+        if(seen >= rank)
+            return qMin(bucketValue(i), maxValue);
+    }
+    return maxValue;
+}
+/* formatUsecs - format a latency in milliseconds
+*/
+static QString formatUsecs(quint32 usecs)
+{
+    return QString::number(usecs / 1000.0, 'f', 2);
+}
+/* summary - return a one line summary of the histogram
+*/
+QString GRELatencyHistogram::summary() const
+{
+    return QString("n %1  p50 %2 ms  p99 %3 ms  max %4 ms")
+            .arg(count)
+            .arg(formatUsecs(percentile(50.0)))
+            .arg(formatUsecs(percentile(99.0)))
+            .arg(formatUsecs(getMax()));
+}
@@ -0,0 +1,145 @@
+/* grelcdmirror.cpp - LCD polling and frame diffing class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/grelcdmirror.h"
+
+#include <cstring>
+
+/* Constructor
+*/
+GRELCDMirror::GRELCDMirror(GREParser *parser, QObject *parent)
+    : QObject(parent), parser(parser)
+{
+    active = false;
+    havePrevious = false;
+    rateFrames = 0;
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(POLL_TIMEOUT);
+    pollTimer->setSingleShot(true);
+    connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollTimeout()));
+    connect(parser, &GREParser::updateLCD, this, &GRELCDMirror::processLCD, Qt::DirectConnection);
+}
+/* Destructor
+*/
+GRELCDMirror::~GRELCDMirror()
+{
+
+}
+/* start - start polling the LCD, the first frame is reported in full
+*/
+void GRELCDMirror::start()
+{
+    active = true;
+    havePrevious = false;
+    rateFrames = 0;
+    rateClock.start();
+    parser->getLcd();
+    pollTimer->start();
+}
+/* stop - stop polling the LCD
+*/
+void GRELCDMirror::stop()
+{
+    active = false;
+    pollTimer->stop();
+}
+/* diffFrames - find the LCD byte ranges and icon bits that differ between two frames
+*/
+void GRELCDMirror::diffFrames(const GREParser::GetLCDVal &previous, const GREParser::GetLCDVal &frame, Changes &changes)
+{
+    changes.rangeCount = 0;
+    changes.iconMask = 0;
+    int i = 0;
+    while(i < GREParser::LCD_SIZE)
+    {
+        // skip equal bytes quickly, most frames are mostly unchanged
+        if(previous.lcd[i] == frame.lcd[i])
+        {
+            i++;
+            continue;
+        }
+        int first = i;
+        int last = i;
+        for(i++; (i < GREParser::LCD_SIZE) && ((i - last) <= RANGE_GAP); i++)
+        {
+            if(previous.lcd[i] != frame.lcd[i])
+                last = i;
+        }
+        i = last + 1;
+        if(changes.rangeCount == MAX_RANGES)
+        {
+            changes.ranges[MAX_RANGES - 1].last = static_cast<quint8>(last);
+        }
+        else
+        {
+            changes.ranges[changes.rangeCount].first = static_cast<quint8>(first);
+            changes.ranges[changes.rangeCount].last = static_cast<quint8>(last);
+            changes.rangeCount++;
+        }
+    }
+    for(int j = 0; j < GREParser::LCD_ICON_SIZE; j++)
+        changes.iconMask |= static_cast<quint32>(previous.icons[j] ^ frame.icons[j]) << (j * 8);
+}
+/* processLCD - compare a new LCD frame with the previous one and poll for the next
+		The next poll goes out as soon as the response arrives, so the rate follows the link
+*/
+void GRELCDMirror::processLCD(const GREParser::GetLCDVal &frame)
+{
+    Changes changes;
+    qint64 elapsed;
+    if(!active)
+        return;
+    parser->getLcd();
+    pollTimer->start();
+    if(havePrevious)
+    {
+        diffFrames(previous, frame, changes);
+    }
+    else
+    {
+        changes.rangeCount = 1;
+        changes.ranges[0].first = 0;
+        changes.ranges[0].last = GREParser::LCD_SIZE - 1;
+        changes.iconMask = (1u << (GREParser::LCD_ICON_SIZE * 8)) - 1;
+        havePrevious = true;
+    }
+    if((changes.rangeCount != 0) || (changes.iconMask != 0))
+    {
+        memcpy(&previous, &frame, sizeof(previous));
+        emit frameChanged(frame, changes);
+    }
+    rateFrames++;
+    elapsed = rateClock.elapsed();
+    if(elapsed >= RATE_INTERVAL)
+    {
+        emit frameRate(rateFrames * 1000.0 / elapsed);
+        rateFrames = 0;
+        rateClock.start();
+    }
+}
+/* pollTimeout - poll again when a response was lost
+*/
+void GRELCDMirror::pollTimeout()
+{
+    if(!active)
+        return;
+    parser->getLcd();
+    pollTimer->start();
+}
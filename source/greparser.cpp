@@ -19,19 +19,90 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 	
 */
 #include "include/greparser.h"
+#include "include/greringbuffer.h"
+#include "include/greprotocol.h"
 
 #include <QString>
 #include <QStringList>
 #include <QDateTime>
 #include <QTimer>
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define GREPARSER_USE_SSE2
+#endif
+
+/* isControlByte - check if a byte can change the parser state while waiting for a packet
+		Every byte up to CAN (0x18) and the 'C' CPU update indication are candidates.
+		The few unused control codes below CAN are sorted out by the state machine.
+*/
+static inline bool isControlByte(unsigned char uc)
+{
+    return (uc <= 0x18) || (uc == 'C');
+}
+/* findControlByte - return the first control byte between it and end, or end if there is none
+		Uses SSE2 to check 16 bytes at a time when available
+*/
+static const char *findControlByte(const char *it, const char *end)
+{
+#ifdef GREPARSER_USE_SSE2
+    const __m128i can = _mm_set1_epi8(0x18);
+    const __m128i cpu = _mm_set1_epi8('C');
+    while((end - it) >= 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        // unsigned v <= CAN is the same as min(v, CAN) == v
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, can), v), _mm_cmpeq_epi8(v, cpu));
+        int mask = _mm_movemask_epi8(hit);
+        if(mask != 0)
+            return it + qCountTrailingZeroBits(static_cast<quint32>(mask));
+        it += 16;
+    }
+#endif
+    while((it != end) && !isControlByte(static_cast<unsigned char>(*it)))
+        it++;
+    return it;
+}
+/* commandLatencySlot - return the latency histogram of a command, -1 if the command has no response
+*/
+static constexpr int commandLatencySlot(char command)
+{
+    return (GREProtocol::findMessage(command)->decoder == GREProtocol::DECODE_NONE) ? -1
+            : GREProtocol::messageIndex.entry[static_cast<quint8>(command)];
+}
 /* Constructor
 */
 GREParser::GREParser(QObject *parent) : QObject(parent)
 {
-    commandData.clear();
-    responseData.clear();
+    responseLength = 0;
+    dataLength = -1;
+    responseChecksum = 0;
+    updateFlagCount = 0;
+    memset(&linkStats, 0, sizeof(linkStats));
+    lastCCDump.reserve(CCDUMP_RESERVE_SIZE);
     mode = MODE_WAIT_START;
     bootloaderActive = false;
+    queueHead = 0;
+    queueCount = 0;
+    inFlightCount = 0;
+    unsolicitedCount = 0;
+    droppedCount = 0;
+    detecting = false;
+    replaying = false;
+    requestTimerDeadline = 0;
+    requestTimer = new QTimer(this);
+    requestTimer->setSingleShot(true);
+    connect(requestTimer, SIGNAL(timeout()), this, SLOT(processRequestTimeout()));
+    detectTimer = new QTimer(this);
+    detectTimer->setSingleShot(true);
+    detectTimer->setInterval(DETECT_TIMEOUT);
+    connect(detectTimer, SIGNAL(timeout()), this, SLOT(processDetectTimeout()));
+    requestClock.start();
+    resetLatency();
 }
 /* Destructor
 */
@@ -39,19 +110,65 @@ GREParser::~GREParser()
 {
 
 }
-/* initialize - initalize data and start bootloader check timer
+/* initialize - initalize data and start detecting the scanner mode
+		The bootloader announces itself with three 'C' characters, which finishes the detection
+		at once. Nothing is sent until the mode is known, a command in the wrong form can start
+		a firmware erase. The application is assumed after DETECT_TIMEOUT.
 */
 void GREParser::initialize()
+{
+    reset();
+    replaying = false;
+    detecting = true;
+    connectClock.start();
+    detectTimer->start();
+}
+/* initializeReplay - initalize data for a capture replay
+		The scanner mode is taken from the replayed data, no detection is started and nothing is
+		sent, so the replayed responses are not matched against requests of this session.
+*/
+void GREParser::initializeReplay()
+{
+    reset();
+    replaying = true;
+}
+/* reset - forget the framing state, requests, statistics and scanner mode
+*/
+void GREParser::reset()
 {
     bootloaderActive = false;
-    commandData.clear();
-    responseData.clear();
+    responseLength = 0;
+    dataLength = -1;
+    responseChecksum = 0;
+    updateFlagCount = 0;
     mode = MODE_WAIT_START;
-    QTimer::singleShot(2000, this, initializeWork); // give time for parser to detect if Bootloader is active
-
+    memset(&linkStats, 0, sizeof(linkStats));
+    clearRequests();
+    unsolicitedCount = 0;
+    droppedCount = 0;
+    resetLatency();
+    detecting = false;
+    detectTimer->stop();
 }
-/* initializeWork - complete initialize function after delay to check for active bootloader
+/* processDetectTimeout - assume the application is running when the bootloader did not announce itself
+*/
+void GREParser::processDetectTimeout()
+{
+    if(detecting)
+        finishDetection();
+}
+/* finishDetection - report how long detection took and send the initial requests
+*/
+void GREParser::finishDetection()
+{
+    detecting = false;
+    detectTimer->stop();
+    emit updateReady(bootloaderActive, connectClock.elapsed());
+    initializeWork();
+}
+/* initializeWork - complete initialize function once it is known if the bootloader is active
 		Bootloader has a very limited command set and invalid commands can cause firmware erasure.
+		The requests go through the request queue, so power status and version are pipelined.
 */
 void GREParser::initializeWork()
 {
@@ -66,165 +183,202 @@ void GREParser::initializeWork()
         requestVersion();
     }
 }
+/* sendCommand - queue a command without payload
+		The descriptor table is checked by the compiler so the command matches its table entry
+*/
+template<char Command>
+void GREParser::sendCommand()
+{
+    static_assert(GREProtocol::findMessage(Command) != nullptr, "command is missing from GREProtocol::messageTable");
+    static_assert(GREProtocol::requestLength(Command) <= 0, "command needs a payload");
+    const char command[1] = { Command };
+    queueCommand(command, 1);
+}
+/* sendCommand - queue a command with a fixed length payload
+*/
+template<char Command, int Length>
+void GREParser::sendCommand(const unsigned char (&payload)[Length])
+{
+    static_assert(GREProtocol::findMessage(Command) != nullptr, "command is missing from GREProtocol::messageTable");
+    static_assert((GREProtocol::requestLength(Command) == Length) || (GREProtocol::requestLength(Command) < 0),
+                  "payload length does not match GREProtocol::messageTable");
+    static_assert(Length < REQUEST_SIZE, "payload does not fit in a queued request");
+    char command[Length + 1];
+    command[0] = Command;
+    memcpy(command + 1, payload, Length);
+    queueCommand(command, Length + 1);
+}
 /* setCCDump - Command to enable/disable CCDump in the scanner
 */
 void GREParser::setCCDump(bool enable)
 {
-    QByteArray command("C");
-    command.append(static_cast<unsigned char>((enable)?1:0));
-    processCommand(command);
+    const unsigned char payload[1] = { static_cast<unsigned char>((enable)?1:0) };
+    sendCommand<'C'>(payload);
 }
 /* getStatus - Command to get status information from the scanner
 */
 void GREParser::getStatus(void )
 {
-    QByteArray command("A");
-    processCommand(command);
+    sendCommand<'A'>();
 }
 /* getLed - command to get LCD display information from the scanner
 */
 void GREParser::getLcd(void )
 {
-    QByteArray command("L");
-    processCommand(command);
-
+    sendCommand<'L'>();
 }
 /* getPowerStatus - command to get power status from the scanner
 */
 void GREParser::getPowerStatus(void )
 {
-    QByteArray command("P");
-    processCommand(command);
-
+    sendCommand<'P'>();
 }
 /* requestVersion - command to request version information from the scanner
 		The format of the command is slightly different when bootloader is active
 */
 void GREParser::requestVersion(void )
 {
-    QByteArray command("V");
-    if(bootloaderActive == false)
-        command.append('\0');
-    processCommand(command);
-
+    const unsigned char payload[1] = { 0 };
+    if(bootloaderActive)
+        sendCommand<'V'>();
+    else
+        sendCommand<'V'>(payload);
 }
 /* clearPassword - command to clear the scanner password
 */
 void GREParser::clearPassword(void )
 {
-    QByteArray command("p");
-    processCommand(command);
-
+    sendCommand<'p'>();
 }
 /* sendPacket - send a data packet to the scanner
+		Firmware packets are paced by the bootloader ENQ/ACK handshake and bypass the request queue
 */
 void GREParser::sendPacket(const QByteArray &data)
 {
-    processCommand(data);
+    stopLatency(LATENCY_TURNAROUND);
+    processCommand(data.constData(), data.size(), LATENCY_PACKET);
+}
+/* sendFrame - send a firmware update packet that is already framed
+		Used with GREFirmware::encodePackets, the frame is sent without being copied or checked
+*/
+void GREParser::sendFrame(const QByteArray &frame)
+{
+    stopLatency(LATENCY_TURNAROUND);
+    startLatency(LATENCY_PACKET);
+    emit sendData(frame);
 }
 /* sendAck - send a packet acknowledgement to the scanner
+		ACK and NAK bypass the request queue so they are never delayed behind other traffic
 */
 void GREParser::sendAck(void )
 {
-    QByteArray ack(1, static_cast<char>(0x06) );
-    emit sendData(ack);
+    static const char ack[1] = { GREProtocol::ACK };
+    if(replaying)
+        return;
+    emit sendData(QByteArray::fromRawData(ack, 1));
 
 }
 /* sendNak - send a packet negative acknowledgement to the scanner
 */
 void GREParser::sendNak(void )
 {
-    QByteArray nak(1,static_cast<char>(0x15));
-    emit sendData(nak);
+    static const char nak[1] = { GREProtocol::NAK };
+    if(replaying)
+        return;
+    emit sendData(QByteArray::fromRawData(nak, 1));
 
 }
+/* putWord - store a 16 bit value in scanner (little endian) order
+*/
+static inline void putWord(unsigned char *p, int value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+}
 /* setDateTime - send the date and time to the scanner
 */
 void GREParser::setDateTime(const QDateTime &datetime)
 {
-    unsigned char uc;
-    QByteArray command("t");
-    uc = datetime.time().second() & 0xff;
-    command.append(uc);
-    uc = (datetime.time().second() >> 8) & 0xff;
-    command.append(uc);
-    uc = datetime.time().minute() & 0xff;
-    command.append(uc);
-    uc = (datetime.time().minute() >> 8) & 0xff;
-    command.append(uc);
-    uc = datetime.time().hour() & 0xff;
-    command.append(uc);
-    uc = (datetime.time().hour() >> 8) & 0xff;
-    command.append(uc);
-    uc = datetime.date().day() & 0xff;
-    command.append(uc);
-    uc = (datetime.date().day() >> 8) & 0xff;
-    command.append(uc);
-    uc = (datetime.date().month() - 1) & 0xff;
-    command.append(uc);
-    uc = ((datetime.date().month() - 1) >> 8) & 0xff;
-    command.append(uc);
-    uc = (datetime.date().year() - 1900) & 0xff;
-    command.append(uc);
-    uc = ((datetime.date().year() - 1900) >> 8) & 0xff;
-    command.append(uc);
-    uc = datetime.date().dayOfWeek() & 0xff;
-    command.append(uc);
-    uc = (datetime.date().dayOfWeek() >> 8) & 0xff;
-    command.append(uc);
-    uc = datetime.date().dayOfYear() & 0xff;
-    command.append(uc);
-    uc = (datetime.date().dayOfYear() >> 8) & 0xff;
-    command.append(uc);
-    command.append(static_cast<unsigned char>(datetime.isDaylightTime())?1:0);
-    uc = 0;
-    command.append(uc);
-    processCommand(command);
+    unsigned char payload[18];
+    putWord(&payload[0], datetime.time().second());
+    putWord(&payload[2], datetime.time().minute());
+    putWord(&payload[4], datetime.time().hour());
+    putWord(&payload[6], datetime.date().day());
+    putWord(&payload[8], datetime.date().month() - 1);
+    putWord(&payload[10], datetime.date().year() - 1900);
+    putWord(&payload[12], datetime.date().dayOfWeek());
+    putWord(&payload[14], datetime.date().dayOfYear());
+    payload[16] = (datetime.isDaylightTime())?1:0;
+    payload[17] = 0;
+    sendCommand<'t'>(payload);
 }
 /* receiveData - receive data from the scanner
 */
-void GREParser::receiveData(QByteArray &data)
+void GREParser::receiveData(const QByteArray &data)
 {
-
-    processResponse(data);
+    processResponse(data.constData(), data.size());
+}
+/* receiveData - receive data from the scanner by consuming the readable spans of a ring buffer in place
+*/
+void GREParser::receiveData(GRERingBuffer &buffer)
+{
+    const char *span;
+    int length;
+    while(((span = buffer.readSpan(length)) != nullptr) && (length > 0))
+    {
+        processResponse(span, length);
+        buffer.consume(length);
+    }
 }
 /* processCommand - packetize the data and send to the scanner
+		The packet is built in one pass in the command buffer and sent as a view of it,
+		so framing does not allocate memory. The send time is kept for the latency histogram.
 */
-void GREParser::processCommand(const QByteArray &data)
+void GREParser::processCommand(const char *data, int length, int latencySlot)
 {
     unsigned char checksum;
-    commandData.clear();
-    if(data.isEmpty())
+    if((length <= 0) || (length > COMMAND_BUFFER_SIZE - 3))
         return;
-    commandData[0] = 0x02; // packet start
-    checksum = 0x03;       // initialize to include data end byte
-    for(QByteArray::const_iterator it = data.cbegin(); it != data.cend(); it++)
+    commandBuffer[0] = GREProtocol::STX;    // packet start
+    checksum = GREProtocol::ETX;            // initialize to include data end byte
+    for(int i = 0; i < length; i++)
     {
-        checksum += *it;
-        commandData.append(*it);
-
+        checksum += data[i];
+        commandBuffer[i + 1] = data[i];
     }
-    commandData.append((unsigned char)0x03);
-    commandData.append(checksum);
-    emit sendData(commandData);
-
+    commandBuffer[length + 1] = GREProtocol::ETX;
+    commandBuffer[length + 2] = checksum;
+    startLatency(latencySlot);
+    emit sendData(QByteArray::fromRawData(commandBuffer, length + 3));
 }
 /* processResponse - process the scanner responseData
-		This function tries to determine the type of data and act based on the type
+		This function tries to determine the type of data and act based on the type.
+		A damaged frame is rescanned for the next packet start by resyncFrame.
 */
-void GREParser::processResponse(const QByteArray &data)
+void GREParser::processResponse(const char *data, int length)
 {
-    static int dataLength = -1;
-    static unsigned char checksum = 0;
-    static int updateFlagCount = 0;
     unsigned char uc;
-    if(data.isEmpty())
+    const char *end = data + length;
+    const char *eol;
+    bool ccDumpChunk;
+    if(length <= 0)
         return;
-    for(QByteArray::const_iterator it = data.cbegin(); it != data.cend(); it++)
+    // Simple check if scanner is doing CCDUMP, done once for the whole chunk
+    ccDumpChunk = (memchr(data, ':', length) != nullptr);
+    for(const char *it = data; it != end; it++)
     {
         switch(mode)
         {
         case MODE_WAIT_START:   // Not in a packet, so wait for start
+            // Skip to the next control byte when there is no CCDUMP to start in this chunk
+            if(!ccDumpChunk && !isControlByte(static_cast<unsigned char>(*it)))
+            {
+                const char *next = findControlByte(it + 1, end);
+                updateFlagCount = 0;
+                linkStats.bytesDiscarded += next - it;
+                it = next - 1; // loop increment moves to the control byte
+                break;
+            }
             switch (*it)
             {
             case 0x02:                     // packet start
@@ -237,10 +391,15 @@ void GREParser::processResponse(const QByteArray &data)
                 break;
             case 0x05:                     // Firmware update wait indication
                 updateFlagCount = 0;
+                if(bootloaderActive)
+                    startLatency(LATENCY_TURNAROUND);
                 emit updateEnq();
                 break;
             case 0x06:                     // Packet Acknowledgement indication
                 updateFlagCount = 0;
+                stopLatency(LATENCY_PACKET);
+                if(bootloaderActive)
+                    startLatency(LATENCY_TURNAROUND);
                 emit updateAck();
                 break;
             case 0x10:                      // Firmware update start indication
@@ -249,6 +408,7 @@ void GREParser::processResponse(const QByteArray &data)
                 break;
             case 0x15:                      // Packet Negative Acknowledgement indication
                 updateFlagCount = 0;
+                stopLatency(LATENCY_PACKET);
                 emit updateNak();
                 break;
             case 0x18:                       // Firmware update cancel indication
@@ -259,15 +419,17 @@ void GREParser::processResponse(const QByteArray &data)
                 if((bootloaderActive == false) && (++updateFlagCount == 3))
                 {
                     bootloaderActive = true;
+                    clearRequests(); // application commands must not reach the bootloader
                     emit updateCpuUpdateMode();
+                    if(detecting)
+                        finishDetection();
                 }
                 break;
             default:
                 updateFlagCount = 0;
-				// Simple check if scanner is doing CCDUMP
-                if(data.contains(":"))
+                if(ccDumpChunk)
                 {
-                    lastCCDump.clear();
+                    lastCCDump.resize(0);
                     lastCCDump.append(*it);
                     mode = MODE_CCDUMP_START;
                 }
@@ -275,37 +437,20 @@ void GREParser::processResponse(const QByteArray &data)
             }
             break;
         case MODE_RESPONSE_START:   // Check command code at the beginning of the packet
-            responseData.clear();
             mode = MODE_RESPONSE_DATA;
-            responseData.append(*it);
-            checksum = *it;
-            switch (responseData.at(0))
-            {
-            case 'A': // Get Status
-                dataLength = 17;
-                break;
-            case 'L': // Get LCD
-                dataLength = 100;
-                break;
-            case 'P': // Get Power Status
-                dataLength = 2;
-                break;
-            case 'V': // Version
-                dataLength = 14;
-                break;
-            default:
-                dataLength = -1;
-                break;
-            }
+            responseBuffer[0] = *it;
+            responseLength = 1;
+            responseChecksum = *it;
+            dataLength = GREProtocol::responseLength(*it);
             break;
         case MODE_RESPONSE_DATA:       // in the data packet
-            checksum += *it;
+            responseChecksum += *it;
             // check the length for packets with a known length and for end of data indicatior
             if((dataLength == -1) && (*it == 0x03)) // Bootloader responses
             {
                 mode = MODE_RESPONSE_DATA_END;
             }
-            else if(responseData.length() == dataLength)
+            else if(responseLength == dataLength)
             {
                 if(*it == 0x03)
                 {
@@ -313,133 +458,52 @@ void GREParser::processResponse(const QByteArray &data)
                 }
                 else
                 {
-                    responseData.clear();
-                    mode = MODE_WAIT_START;
+                    linkStats.lengthErrors++;
+                    resyncFrame(it, 1);
                 }
             }
+            else if(responseLength == RESPONSE_BUFFER_SIZE) // runaway frame without an end of data indicator
+            {
+                linkStats.lengthErrors++;
+                resyncFrame(it, 1);
+            }
             else
             {
-                responseData.append(*it);
+                responseBuffer[responseLength++] = *it;
             }
             break;
         case MODE_RESPONSE_DATA_END:  // End of the packet
             uc = *it;
             // check the data and decode if good
-            if(checksum == uc)
+            if(responseChecksum == uc)
             {
-                switch (responseData.at(0))
+                // view of the completed frame, valid only until the next byte is processed
+                const QByteArray responseData = QByteArray::fromRawData(responseBuffer, responseLength);
+                const GREProtocol::MessageInfo *info = GREProtocol::findMessage(responseData.at(0));
+                completeRequest(responseData.at(0));
+                emit updateFrame(responseData);
+                if((info != nullptr) && (info->decoder != GREProtocol::DECODE_NONE))
                 {
-                case 'A': // Get Status
-                    lastGetStatusVal.mode = responseData.at(1);
-                    lastGetStatusVal.flags = responseData.at(2);
-                    lastGetStatusVal.usbPower = (responseData.at(4) & 0x80)?true:false;
-                    lastGetStatusVal.battery = (responseData.at(3) | (responseData.at(4) << 8)) & 0x7FFF;
-                    lastGetStatusVal.rssi = (responseData.at(5) | (responseData.at(6) << 8));
-                    lastGetStatusVal.zeromatic = (responseData.at(7) | (responseData.at(8) << 8));
-                    lastGetStatusVal.rLed = responseData.at(9);
-                    lastGetStatusVal.gLed = responseData.at(10);
-                    lastGetStatusVal.bLed = responseData.at(11);
-                    lastGetStatusVal.frequency = responseData.at(12) | (responseData.at(13) << 8) ||
-                                                (responseData.at(14) << 16) | (responseData.at(15) << 24);
-                    lastGetStatusVal.rxmode =  responseData.at(17);
-                    emit updateStatus(lastGetStatusVal);
-                    break;
-                case 'L': // Get LCD
-                    lastGetLCDVal.lcd = responseData.mid(1,97);
-                    lastGetLCDVal.icons = responseData.right(3);
-                    emit updateLCD(lastGetLCDVal);
-                    break;
-                case 'P': // Get Power Status
-                    lastPowerStatusVal = (responseData.at(1))?true:false;
-                    emit updatePowerStatus(lastPowerStatusVal);
-                    break;
-                case 'V': // Version
-                    lastVersionVal.model = responseData.mid(2, 8);
-                    uc = responseData.at(10);
-                    switch(uc)
-                    {
-                    case 0:
-                        lastVersionVal.ver1 = QString("Boot N/A");
-                        break;
-                    case 255:
-                        lastVersionVal.ver1 = QString("Boot Erased");
-                        break;
-                    default:
-                        lastVersionVal.ver1 = QString("Boot %1.%2").arg(uc >> 4, 0, 16).arg(uc & 0xF, 0, 16);
-                        break;
-                    }
-                    uc = responseData.at(11);
-                    switch(uc)
-                    {
-                    case 0:
-                        lastVersionVal.ver2 = QString("CPU N/A");
-                        break;
-                    case 255:
-                        lastVersionVal.ver2 = QString("CPU Erased");
-                        break;
-                    default:
-                        lastVersionVal.ver2 = QString("CPU %1.%2").arg(uc >> 4, 0, 16).arg(uc & 0xF, 0, 16);
-                        break;
-                    }
-                    uc = responseData.at(12);
-                    switch(uc)
-                    {
-                    case 0:
-                        lastVersionVal.ver3 = QString("DSP N/A");
-                        break;
-                    case 255:
-                        lastVersionVal.ver3 = QString("DSP Erased");
-                        break;
-                    default:
-                        lastVersionVal.ver3 = QString("DSP %1.%2").arg(uc >> 4, 0, 16).arg(uc & 0xF, 0, 16);
-                        break;
-                    }
-                    uc = responseData.at(13);
-                    switch(uc)
-                    {
-                    case 0:
-                        lastVersionVal.ver4 = QString("Voc N/A");
-                        break;
-                    case 255:
-                        lastVersionVal.ver4 = QString("Voc Erased");
-                        break;
-                    default:
-                        lastVersionVal.ver4 = QString("Voc %1.%2").arg(uc >> 4, 0, 16).arg(uc & 0xF, 0, 16);
-                        break;
-                    }
-                    emit updateVersion(lastVersionVal);
-                    break;
-                default:
-                    // bootloader only returns version information
-                    if(bootloaderActive)
-                    {
-                        lastVersionVal.model.clear();
-                        if((responseData.at(0) == QLatin1Char('F')) && (responseData.at(0) == responseData.at(1)))
-                                lastVersionVal.ver1 = QString("Boot Erased"); // Impossible case
-                        else
-                                lastVersionVal.ver1 = QString("Boot %1.%2").arg(responseData.at(0)).arg(responseData.at(1));
-
-                         if((responseData.at(2) == QLatin1Char('F')) && (responseData.at(2) == responseData.at(3)))
-                                lastVersionVal.ver2 = QString("CPU Erased");
-                         else
-                                lastVersionVal.ver2 = QString("CPU %1.%2").arg(responseData.at(2)).arg(responseData.at(3));
-                         lastVersionVal.ver3.clear();
-                         lastVersionVal.ver4.clear();
-                         emit updateVersion(lastVersionVal);
-                         // bootloader expects ACK or NAK
-                         sendAck();
-                    }
-                    break;
+                    (this->*responseDecoders[info->decoder])(responseData);
+                    if(detecting)   // a decoded application response shows the application is running
+                        finishDetection();
+                }
+                else
+                {
+                    decodeBootloaderVersion(responseData); // bootloader only returns version information
                 }
             }
-            else // bad checksum so clear
+            else // bad checksum so look for a packet start inside the frame
             {
-                responseData.clear();
+                const char tail[2] = { GREProtocol::ETX, *it };
+                linkStats.checksumErrors++;
                 // bootloader expects ACK or NAK
                 if(bootloaderActive)
                 {
                     sendNak();
                 }
+                resyncFrame(tail, 2);
+                break;
             }
             mode = MODE_WAIT_START;
             break;
@@ -448,9 +512,17 @@ void GREParser::processResponse(const QByteArray &data)
             mode = MODE_CCDUMP_DATA;
             break;
         case MODE_CCDUMP_DATA:                  // CCDump continues
-            lastCCDump.append(*it);
-            if(*it == 0x0a)
+            // copy everything up to and including the end of line in one step
+            eol = static_cast<const char *>(memchr(it, 0x0a, end - it));
+            if(eol == nullptr)
+            {
+                lastCCDump.append(it, static_cast<int>(end - it));
+                it = end - 1;
+            }
+            else
             {
+                lastCCDump.append(it, static_cast<int>(eol - it + 1));
+                it = eol;
                 emit updateCCDump(lastCCDump);
                 mode = MODE_WAIT_START;
             }
@@ -459,3 +531,316 @@ void GREParser::processResponse(const QByteArray &data)
 
     }
 }
+/* resyncFrame - rescan the bytes of a failed frame for the next packet start
+		The bytes after the failed STX are already buffered, so they are fed through the parser
+		again from the first STX found instead of being thrown away. Every nested resync starts
+		further into the frame, so the recursion is bounded by the frame length.
+*/
+void GREParser::resyncFrame(const char *tail, int tailLength)
+{
+    char bytes[RESPONSE_BUFFER_SIZE + 2];
+    int count = responseLength;
+    const char *start;
+    memcpy(bytes, responseBuffer, count);
+    memcpy(bytes + count, tail, tailLength);
+    count += tailLength;
+    responseLength = 0;
+    mode = MODE_WAIT_START;
+    emit updateFrameError(QByteArray::fromRawData(bytes, count));
+    start = static_cast<const char *>(memchr(bytes, GREProtocol::STX, count));
+    if(start == nullptr)
+    {
+        linkStats.bytesDiscarded += count + 1;   // the frame and its STX
+        return;
+    }
+    linkStats.bytesDiscarded += (start - bytes) + 1;
+    linkStats.resyncEvents++;
+    processResponse(start, count - static_cast<int>(start - bytes));
+}
+/* Response decoders in GREProtocol::Decoder order
+*/
+const GREParser::ResponseDecoder GREParser::responseDecoders[GREProtocol::DECODE_COUNT] =
+{
+    nullptr,                            // DECODE_NONE
+    &GREParser::decodeStatus,           // DECODE_STATUS
+    &GREParser::decodeLcd,              // DECODE_LCD
+    &GREParser::decodePowerStatus,      // DECODE_POWER_STATUS
+    &GREParser::decodeVersion,          // DECODE_VERSION
+};
+/* decodeStatus - decode the 'A' Get Status response
+*/
+void GREParser::decodeStatus(const QByteArray &responseData)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(responseData.constData());
+    lastGetStatusVal.mode = p[1];
+    lastGetStatusVal.flags = p[2];
+    lastGetStatusVal.usbPower = (p[4] & 0x80)?true:false;
+    lastGetStatusVal.battery = (p[3] | (p[4] << 8)) & 0x7FFF;
+    lastGetStatusVal.rssi = (p[5] | (p[6] << 8));
+    lastGetStatusVal.zeromatic = (p[7] | (p[8] << 8));
+    lastGetStatusVal.rLed = p[9];
+    lastGetStatusVal.gLed = p[10];
+    lastGetStatusVal.bLed = p[11];
+    lastGetStatusVal.frequency = p[12] | (p[13] << 8) | (p[14] << 16) | (static_cast<quint32>(p[15]) << 24);
+    lastGetStatusVal.rxmode = p[16];
+    emit updateStatus(lastGetStatusVal);
+}
+/* decodeLcd - decode the 'L' Get LCD response
+		The icon bytes are the last three bytes of the response
+*/
+void GREParser::decodeLcd(const QByteArray &responseData)
+{
+    memcpy(lastGetLCDVal.lcd, responseData.constData() + 1, LCD_SIZE);
+    memcpy(lastGetLCDVal.icons, responseData.constData() + responseData.size() - LCD_ICON_SIZE, LCD_ICON_SIZE);
+    emit updateLCD(lastGetLCDVal);
+}
+/* decodePowerStatus - decode the 'P' Get Power Status response
+*/
+void GREParser::decodePowerStatus(const QByteArray &responseData)
+{
+    lastPowerStatusVal = (responseData.at(1))?true:false;
+    emit updatePowerStatus(lastPowerStatusVal);
+}
+/* decodeVersion - decode the 'V' Version response
+*/
+void GREParser::decodeVersion(const QByteArray &responseData)
+{
+    memcpy(lastVersionVal.model, responseData.constData() + 2, sizeof(lastVersionVal.model));
+    memcpy(lastVersionVal.version, responseData.constData() + 10, sizeof(lastVersionVal.version));
+    lastVersionVal.bootloader = false;
+    emit updateVersion(lastVersionVal);
+}
+/* decodeBootloaderVersion - decode the version response of an active bootloader
+		The bootloader only returns version information and expects ACK or NAK
+*/
+void GREParser::decodeBootloaderVersion(const QByteArray &responseData)
+{
+    if(bootloaderActive)
+    {
+        memset(lastVersionVal.model, 0, sizeof(lastVersionVal.model));
+        memset(lastVersionVal.version, 0, sizeof(lastVersionVal.version));
+        memcpy(lastVersionVal.version, responseData.constData(), qMin(responseData.size(), 4));
+        lastVersionVal.bootloader = true;
+        emit updateVersion(lastVersionVal);
+        // bootloader expects ACK or NAK
+        sendAck();
+    }
+}
+/* formatVersionPart - format one application version byte
+*/
+static QString formatVersionPart(const char *name, quint8 uc)
+{
+    switch(uc)
+    {
+    case 0:
+        return QString("%1 N/A").arg(name);
+    case 255:
+        return QString("%1 Erased").arg(name);
+    default:
+        return QString("%1 %2.%3").arg(name).arg(uc >> 4, 0, 16).arg(uc & 0xF, 0, 16);
+    }
+}
+/* formatBootloaderPart - format one version reported by the bootloader as two ASCII digits
+*/
+static QString formatBootloaderPart(const char *name, const quint8 *digits)
+{
+    if((digits[0] == 'F') && (digits[0] == digits[1]))
+        return QString("%1 Erased").arg(name);
+    return QString("%1 %2.%3").arg(name).arg(QLatin1Char(digits[0])).arg(QLatin1Char(digits[1]));
+}
+/* formatVersion - return the display text of a version response
+		Formatting is left to the consumer so polling does not build strings nobody reads
+*/
+QString GREParser::formatVersion(const VersionVal &data)
+{
+    QString model = QString::fromUtf8(data.model, qstrnlen(data.model, sizeof(data.model)));
+    if(data.bootloader)
+    {
+        return QString("%1  %2  %3    ").arg(model)
+                .arg(formatBootloaderPart("Boot", &data.version[0]))
+                .arg(formatBootloaderPart("CPU", &data.version[2]));
+    }
+    return QString("%1  %2  %3  %4  %5").arg(model)
+            .arg(formatVersionPart("Boot", data.version[0]))
+            .arg(formatVersionPart("CPU", data.version[1]))
+            .arg(formatVersionPart("DSP", data.version[2]))
+            .arg(formatVersionPart("Voc", data.version[3]));
+}
+/* queueCommand - add a command to the request queue and send what the pipeline allows
+		A poll that is already waiting in the queue is not queued again. Nothing is sent during a replay.
+*/
+void GREParser::queueCommand(const char *data, int length)
+{
+    int index;
+    if((length <= 0) || (length > REQUEST_SIZE) || replaying)
+        return;
+    for(int i = 0; i < queueCount; i++)
+    {
+        const Request &request = requestQueue[(queueHead + i) % REQUEST_QUEUE_SIZE];
+        if((request.length == length) && (memcmp(request.data, data, length) == 0) && GREProtocol::expectsResponse(data[0]))
+            return;
+    }
+    if(queueCount == REQUEST_QUEUE_SIZE)
+        return;
+    index = (queueHead + queueCount) % REQUEST_QUEUE_SIZE;
+    memcpy(requestQueue[index].data, data, length);
+    requestQueue[index].length = length;
+    queueCount++;
+    dispatchRequests();
+}
+/* dispatchRequests - send queued commands in order while the pipeline has room
+		Only one response per command code can be outstanding so every response matches one request.
+		The bootloader gets one request at a time and only commands it knows.
+*/
+void GREParser::dispatchRequests()
+{
+    const int depth = bootloaderActive ? 1 : PIPELINE_DEPTH;
+    while(queueCount > 0)
+    {
+        const Request &request = requestQueue[queueHead];
+        const GREProtocol::MessageInfo *info = GREProtocol::findMessage(request.data[0]);
+        const quint8 modeFlag = bootloaderActive ? GREProtocol::MODE_BOOTLOADER : GREProtocol::MODE_APPLICATION;
+        if((info != nullptr) && ((info->modes & modeFlag) != 0) && (info->timeout != 0))
+        {
+            bool outstanding = false;
+            for(int i = 0; i < inFlightCount; i++)
+                if(inFlight[i].command == info->command)
+                    outstanding = true;
+            if(outstanding || (inFlightCount >= depth))
+                break;
+            inFlight[inFlightCount].command = info->command;
+            inFlight[inFlightCount].latencySlot = commandLatencySlot(info->command);
+            inFlight[inFlightCount].deadline = requestClock.elapsed() + info->timeout;
+            inFlightCount++;
+            processCommand(request.data, request.length, commandLatencySlot(info->command));
+            startRequestTimer();
+        }
+        else if((info != nullptr) && ((info->modes & modeFlag) != 0))
+        {
+            processCommand(request.data, request.length, -1);
+        }
+        else
+        {
+            droppedCount++;     // never send a command the scanner mode does not know
+        }
+        queueHead = (queueHead + 1) % REQUEST_QUEUE_SIZE;
+        queueCount--;
+    }
+}
+/* completeRequest - match a response to its request and let the next request go
+		The bootloader version response has no command byte, but the bootloader only has one request outstanding
+*/
+void GREParser::completeRequest(char command)
+{
+    int i;
+    // a replay sends no requests, so its responses are neither matched nor counted
+    if(replaying)
+        return;
+    // a reply to a command sent without waiting for a response is expected, not unsolicited
+    if(!bootloaderActive && (GREProtocol::findMessage(command) != nullptr) && !GREProtocol::expectsResponse(command))
+        return;
+    for(i = 0; i < inFlightCount; i++)
+        if(bootloaderActive || (inFlight[i].command == command))
+            break;
+    if(i == inFlightCount)
+    {
+        unsolicitedCount++;
+        return;
+    }
+    stopLatency(inFlight[i].latencySlot);
+    for(inFlightCount--; i < inFlightCount; i++)
+        inFlight[i] = inFlight[i + 1];
+    startRequestTimer();
+    dispatchRequests();
+}
+/* clearRequests - forget queued and outstanding requests
+*/
+void GREParser::clearRequests()
+{
+    queueHead = 0;
+    queueCount = 0;
+    inFlightCount = 0;
+    requestTimer->stop();
+}
+/* startRequestTimer - make sure the request timer expires no later than the earliest outstanding deadline
+		The timer is restarted whenever a request has an earlier deadline than the running timer,
+		so a short timeout queued behind a long one is reported on time. A running timer that
+		expires earlier is left alone, processRequestTimeout arms it again for the requests still
+		outstanding. A timer left running with nothing outstanding expires once and finds nothing to do.
+*/
+void GREParser::startRequestTimer()
+{
+    qint64 deadline;
+    if(inFlightCount == 0)
+        return;
+    deadline = inFlight[0].deadline;
+    for(int i = 1; i < inFlightCount; i++)
+        deadline = qMin(deadline, inFlight[i].deadline);
+    if(!requestTimer->isActive() || (deadline < requestTimerDeadline))
+    {
+        requestTimerDeadline = deadline;
+        requestTimer->start(static_cast<int>(qMax<qint64>(deadline - requestClock.elapsed(), 0)));
+    }
+}
+/* processRequestTimeout - give up on requests whose response did not arrive in time
+*/
+void GREParser::processRequestTimeout()
+{
+    const qint64 now = requestClock.elapsed();
+    int i = 0;
+    while(i < inFlightCount)
+    {
+        if(inFlight[i].deadline > now)
+        {
+            i++;
+            continue;
+        }
+        char command = inFlight[i].command;
+        if(inFlight[i].latencySlot >= 0)
+            latencyStart[inFlight[i].latencySlot] = -1;
+        inFlightCount--;
+        for(int j = i; j < inFlightCount; j++)
+            inFlight[j] = inFlight[j + 1];
+        emit requestTimeout(command);
+    }
+    startRequestTimer();
+    dispatchRequests();
+}
+/* startLatency - note the time a request is sent
+*/
+void GREParser::startLatency(int slot)
+{
+    if(slot >= 0)
+        latencyStart[slot] = requestClock.nsecsElapsed();
+}
+/* stopLatency - record the latency of an outstanding request when its response arrives
+*/
+void GREParser::stopLatency(int slot)
+{
+    if((slot < 0) || (latencyStart[slot] < 0))
+        return;
+    latency[slot].record(static_cast<quint32>(qMin<qint64>((requestClock.nsecsElapsed() - latencyStart[slot]) / 1000, 0xffffffff)));
+    latencyStart[slot] = -1;
+}
+/* resetLatency - clear the latency histograms and forget outstanding requests
+*/
+void GREParser::resetLatency()
+{
+    for(int i = 0; i < LATENCY_COUNT; i++)
+    {
+        latencyStart[i] = -1;
+        latency[i].reset();
+    }
+}
+/* latencyName - return the display name of a latency histogram
+*/
+QString GREParser::latencyName(int slot)
+{
+    if((slot >= 0) && (slot < GREProtocol::messageTableSize))
+        return QString("Command '%1' response").arg(QLatin1Char(GREProtocol::messageTable[slot].command));
+    if(slot == LATENCY_PACKET)
+        return QString("Firmware packet to ACK");
+    if(slot == LATENCY_TURNAROUND)
+        return QString("ENQ/ACK to next packet");
+    return QString();
+}
@@ -0,0 +1,99 @@
+/* greringbuffer.cpp - A simple fixed capacity receive ring buffer class
+        The serial port reads straight into the free span and the parser consumes the
+        readable span in place, so no memory is allocated after construction.
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/greringbuffer.h"
+
+/* Constructor
+		The capacity is rounded up to a power of two so positions can be wrapped with a mask
+*/
+GRERingBuffer::GRERingBuffer(int capacity)
+{
+    bufferSize = 64;
+    while(bufferSize < capacity)
+        bufferSize <<= 1;
+    buffer = new char[bufferSize];
+    allocations = 1;
+    totalBytes = 0;
+    clear();
+}
+/* Destructor
+*/
+GRERingBuffer::~GRERingBuffer()
+{
+    delete[] buffer;
+}
+/* writeSpan - return the contiguous free space following the last written byte
+*/
+char *GRERingBuffer::writeSpan(int &length)
+{
+    if(tail >= head && used < bufferSize)
+        length = bufferSize - tail;
+    else
+        length = head - tail;
+    return buffer + tail;
+}
+/* commit - mark bytes written into the span from writeSpan as readable
+*/
+void GRERingBuffer::commit(int length)
+{
+    if(length <= 0)
+        return;
+    if(length > getFree())
+        length = getFree();
+    tail = (tail + length) & (bufferSize - 1);
+    used += length;
+    totalBytes += length;
+}
+/* readSpan - return the contiguous readable bytes following the last consumed byte
+*/
+const char *GRERingBuffer::readSpan(int &length) const
+{
+    if(used == 0)
+        length = 0;
+    else if(head < tail)
+        length = tail - head;
+    else
+        length = bufferSize - head;
+    return buffer + head;
+}
+/* consume - release bytes returned by readSpan
+*/
+void GRERingBuffer::consume(int length)
+{
+    if(length <= 0)
+        return;
+    if(length > used)
+        length = used;
+    head = (head + length) & (bufferSize - 1);
+    used -= length;
+    // restart at the beginning when empty to keep spans as long as possible
+    if(used == 0)
+        head = tail = 0;
+}
+/* clear - discard all buffered bytes
+*/
+void GRERingBuffer::clear()
+{
+    head = 0;
+    tail = 0;
+    used = 0;
+}
@@ -0,0 +1,225 @@
+/* gretrace.cpp - A bounded raw protocol trace class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/gretrace.h"
+#include "include/greprotocol.h"
+
+#include <cstring>
+
+static const char hexDigits[] = "0123456789abcdef";
+
+/* controlName - return the name of a control byte, nullptr if it is not one
+*/
+static const char *controlName(unsigned char c)
+{
+    switch(c)
+    {
+    case GREProtocol::EOT:
+        return "EOT";
+    case GREProtocol::ENQ:
+        return "ENQ";
+    case GREProtocol::ACK:
+        return "ACK";
+    case GREProtocol::DLE:
+        return "DLE";
+    case GREProtocol::NAK:
+        return "NAK";
+    case GREProtocol::CAN:
+        return "CAN";
+    case 'C':
+        return "CPU update mode";
+    default:
+        return nullptr;
+    }
+}
+/* putText - store a Latin-1 text and return the position after it
+*/
+static inline QChar *putText(QChar *p, const char *text)
+{
+    while(*text != '\0')
+        *p++ = QLatin1Char(*text++);
+    return p;
+}
+/* formatBytes - append the hex and ASCII form of the bytes to a string in one pass
+		The string is sized once and filled in place instead of one QString::arg per byte
+*/
+static void formatBytes(QString &text, const char *data, int length)
+{
+    int start = text.size();
+    int hexSize = length * 3;
+    int asciiSize = 0;
+    for(int i = 0; i < length; i++)
+    {
+        unsigned char c = data[i];
+        asciiSize += ((c >= ' ') && (c <= '~')) ? 1 : 4;
+    }
+    text.resize(start + 5 + hexSize + 7 + asciiSize + 1);
+    QChar *p = putText(text.data() + start, "Hex: ");
+    for(int i = 0; i < length; i++)
+    {
+        unsigned char c = data[i];
+        *p++ = QLatin1Char(hexDigits[c >> 4]);
+        *p++ = QLatin1Char(hexDigits[c & 0x0f]);
+        *p++ = QLatin1Char(' ');
+    }
+    p = putText(p, "Ascii: ");
+    for(int i = 0; i < length; i++)
+    {
+        unsigned char c = data[i];
+        if((c >= ' ') && (c <= '~'))
+        {
+            *p++ = QLatin1Char(c);
+        }
+        else
+        {
+            *p++ = QLatin1Char('<');
+            *p++ = QLatin1Char(hexDigits[c >> 4]);
+            *p++ = QLatin1Char(hexDigits[c & 0x0f]);
+            *p++ = QLatin1Char('>');
+        }
+    }
+    *p++ = QLatin1Char(']');
+    text.resize(static_cast<int>(p - text.constData()));
+}
+/* Constructor
+		The capacity is rounded up to a power of two so positions can be wrapped with a mask
+*/
+GRETrace::GRETrace(int capacity)
+{
+    bufferSize = 4096;
+    while(bufferSize < capacity)
+        bufferSize <<= 1;
+    buffer = new char[bufferSize];
+    entries = new Entry[MAX_ENTRIES];
+    clear();
+}
+/* Destructor
+*/
+GRETrace::~GRETrace()
+{
+    delete[] entries;
+    delete[] buffer;
+}
+/* clear - discard all entries and restart the trace clock
+*/
+void GRETrace::clear()
+{
+    writePosition = 0;
+    entryCount = 0;
+    clock.start();
+}
+/* record - copy one event into the trace, the oldest entries are overwritten when full
+*/
+void GRETrace::record(Kind kind, const char *data, int length)
+{
+    int offset;
+    int first;
+    if(length > (bufferSize / 4))
+        length = bufferSize / 4;
+    Entry &item = entries[entryCount & (MAX_ENTRIES - 1)];
+    item.position = writePosition;
+    item.msecs = clock.elapsed();
+    item.length = length;
+    item.kind = kind;
+    offset = static_cast<int>(writePosition & (bufferSize - 1));
+    first = qMin(length, bufferSize - offset);
+    memcpy(buffer + offset, data, first);
+    memcpy(buffer, data + first, length - first);
+    writePosition += length;
+    entryCount++;
+}
+/* getEntryCount - return the number of entries whose data is still in the trace
+*/
+int GRETrace::getEntryCount() const
+{
+    // the entries with intact data are the newest ones, binary search for the oldest of them
+    int low = 0;
+    int high = static_cast<int>(qMin<quint64>(entryCount, MAX_ENTRIES));
+    while(low < high)
+    {
+        int count = (low + high + 1) / 2;
+        if((writePosition - entries[(entryCount - count) & (MAX_ENTRIES - 1)].position) <= static_cast<quint64>(bufferSize))
+            low = count;
+        else
+            high = count - 1;
+    }
+    return low;
+}
+/* entry - return an entry, index 0 is the oldest of getEntryCount entries
+*/
+const GRETrace::Entry &GRETrace::entry(int index) const
+{
+    return entries[(entryCount - getEntryCount() + index) & (MAX_ENTRIES - 1)];
+}
+/* getEntryKind - return the kind of an entry
+*/
+GRETrace::Kind GRETrace::getEntryKind(int index) const
+{
+    return entry(index).kind;
+}
+/* copyData - copy the data of an entry out of the ring
+*/
+void GRETrace::copyData(const Entry &item, char *data) const
+{
+    int offset = static_cast<int>(item.position & (bufferSize - 1));
+    int first = qMin(item.length, bufferSize - offset);
+    memcpy(data, buffer + offset, first);
+    memcpy(data + first, buffer, item.length - first);
+}
+/* formatEntry - return the display text of an entry
+*/
+QString GRETrace::formatEntry(int index) const
+{
+    const Entry &item = entry(index);
+    QByteArray data(item.length, Qt::Uninitialized);
+    QString text = QString("%1 ").arg(item.msecs / 1000.0, 0, 'f', 3);
+    const char *name;
+    copyData(item, data.data());
+    switch(item.kind)
+    {
+    case TRACE_TX_BYTES:
+    case TRACE_TX_FRAME:
+        text.append(QLatin1String((item.kind == TRACE_TX_FRAME) ? "Tx frame[" : "Tx["));
+        formatBytes(text, data.constData(), data.size());
+        break;
+    case TRACE_RX_BYTES:
+    case TRACE_RX_FRAME:
+        text.append(QLatin1String((item.kind == TRACE_RX_FRAME) ? "Rx frame[" : "Rx["));
+        formatBytes(text, data.constData(), data.size());
+        break;
+    case TRACE_TX_CONTROL:
+    case TRACE_RX_CONTROL:
+        name = (data.isEmpty()) ? nullptr : controlName(data.at(0));
+        text.append(QLatin1String((item.kind == TRACE_TX_CONTROL) ? "Tx " : "Rx "));
+        if(name != nullptr)
+            text.append(QLatin1String(name));
+        else
+            formatBytes(text.append(QLatin1Char('[')), data.constData(), data.size());
+        break;
+    case TRACE_DAMAGED_FRAME:
+        text.append(QLatin1String("Rx damaged frame["));
+        formatBytes(text, data.constData(), data.size());
+        break;
+    case TRACE_TIMEOUT:
+        text.append(QString("No response to command '%1'").arg(QLatin1String(data)));
+        break;
+    }
+    return text;
+}
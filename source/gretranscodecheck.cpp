@@ -0,0 +1,204 @@
+/* gretranscodecheck.cpp - Checks every firmware image against every supported transcode
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/gretranscodecheck.h"
+#include "include/grefirmware.h"
+#include "include/gre7zarchive.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+// A loaded firmware file and one target platform to check it against
+struct CheckJob {
+    QString fileName;
+    QByteArray file;        // shared by all the jobs of the file
+    quint8 target;
+};
+
+/* loadFile - read a firmware file or decode a 7z archive, empty on error
+*/
+static QByteArray loadFile(const QString &fileName)
+{
+    QByteArray file;
+    if(GRE7zArchive::isArchiveName(fileName))
+    {
+        if(!GRE7zArchive::readFile(fileName, file))
+            file.clear();
+        return file;
+    }
+    QFile imageFile(fileName);
+    if(imageFile.open(QIODevice::ReadOnly))
+        file = imageFile.readAll();
+    return file;
+}
+/* checkJob - transcode one image to one target and back
+*/
+static GRETranscodeCheck::Result checkJob(const CheckJob &job)
+{
+    GRETranscodeCheck::Result result;
+    GREFirmware forward;
+    GREFirmware stream;
+    GREFirmware back;
+    QVector<qint32> fixups;
+    result.fileName = job.fileName;
+    result.platform = static_cast<quint8>(job.file.at(0));
+    result.version = GREFirmware::decodeVersion(result.platform, job.file.constData() + GREFirmware::HEADER_SIZE, job.file.size() - GREFirmware::HEADER_SIZE);
+    result.target = job.target;
+    result.patchedBytes = 0;
+    result.status = GRETranscodeCheck::STATUS_OK;
+    // batch transcode, then the streaming transcode must produce the same packets
+    forward.loadBuffer(job.file);
+    fixups = forward.getPatchOffsets(job.target);
+    if(!forward.transcode(job.target))
+    {
+        result.status = GRETranscodeCheck::STATUS_UNSUPPORTED;
+        return result;
+    }
+    stream.loadBuffer(job.file);
+    if(!stream.beginTranscode(job.target) || !forward.encodePackets() || !stream.encodePackets() ||
+            (forward.getFrameTable() != stream.getFrameTable()))
+    {
+        result.status = GRETranscodeCheck::STATUS_STREAM_MISMATCH;
+        return result;
+    }
+    // transcode back, only the fixups of either direction may differ from the original
+    if(!GREFirmware::isTranscodeSupported(job.target, result.platform))
+    {
+        result.status = GRETranscodeCheck::STATUS_NO_ROUND_TRIP;
+        return result;
+    }
+    QByteArray transcoded = job.file.left(GREFirmware::HEADER_SIZE);
+    transcoded[0] = static_cast<char>(job.target);
+    transcoded.append(forward.getImageData());
+    back.loadBuffer(transcoded);
+    fixups += back.getPatchOffsets(result.platform);
+    if(!back.transcode(result.platform))
+    {
+        result.status = GRETranscodeCheck::STATUS_ROUND_TRIP_UNSUPPORTED;
+        return result;
+    }
+    const char *original = job.file.constData() + GREFirmware::HEADER_SIZE;
+    const char *roundTrip = back.getImageData().constData();
+    for(int i = 0; i < back.getImageData().size(); i++)
+    {
+        if(original[i] == roundTrip[i])
+            continue;
+        if(!fixups.contains(i))
+        {
+            result.status = GRETranscodeCheck::STATUS_ROUND_TRIP_MISMATCH;
+            return result;
+        }
+        result.patchedBytes++;
+    }
+    return result;
+}
+/* run - check every file against every target platform it can be transcoded to
+		The files are loaded in parallel, then every file and target pair is checked in parallel.
+		Results are in file order, then target order.
+*/
+QVector<GRETranscodeCheck::Result> GRETranscodeCheck::run(const QStringList &fileNames)
+{
+    QVector<Result> results;
+    QList<CheckJob> jobs;
+    QList<QByteArray> files = QtConcurrent::blockingMapped(fileNames, loadFile);
+    for(int i = 0; i < fileNames.size(); i++)
+    {
+        const QByteArray &file = files.at(i);
+        GREFirmware firmware;
+        if(!firmware.loadBuffer(file))
+        {
+            Result result;
+            result.fileName = fileNames.at(i);
+            result.platform = file.isEmpty() ? 0 : static_cast<quint8>(file.at(0));
+            result.version = 0;
+            result.target = 0;
+            result.status = STATUS_LOAD_ERROR;
+            result.patchedBytes = 0;
+            results.append(result);
+            continue;
+        }
+        for(int pair = 0; pair < GREFirmware::getTranscodeCount(); pair++)
+        {
+            quint8 oldPlatform;
+            quint8 newPlatform;
+            GREFirmware::getTranscodePair(pair, oldPlatform, newPlatform);
+            if(oldPlatform != firmware.getPlatform())
+                continue;
+            CheckJob job;
+            job.fileName = fileNames.at(i);
+            job.file = file;
+            job.target = newPlatform;
+            jobs.append(job);
+        }
+    }
+    QList<Result> checked = QtConcurrent::blockingMapped(jobs, checkJob);
+    foreach(const Result &result, checked)
+        results.append(result);
+    // keep the report in file order with the load errors in their place
+    QHash<QString, int> fileOrder;
+    for(int i = fileNames.size() - 1; i >= 0; i--)
+        fileOrder.insert(fileNames.at(i), i);
+    std::stable_sort(results.begin(), results.end(), [&fileOrder](const Result &a, const Result &b) {
+        return fileOrder.value(a.fileName) < fileOrder.value(b.fileName);
+    });
+    return results;
+}
+/* statusName - return a short description of a check status
+*/
+QString GRETranscodeCheck::statusName(Status status)
+{
+    switch(status)
+    {
+    case STATUS_OK:
+        return QStringLiteral("ok");
+    case STATUS_NO_ROUND_TRIP:
+        return QStringLiteral("ok, no transcode back to check");
+    case STATUS_LOAD_ERROR:
+        return QStringLiteral("not a valid firmware file");
+    case STATUS_UNSUPPORTED:
+        return QStringLiteral("transcode not supported for this version");
+    case STATUS_STREAM_MISMATCH:
+        return QStringLiteral("streaming transcode differs from batch transcode");
+    case STATUS_ROUND_TRIP_UNSUPPORTED:
+        return QStringLiteral("transcode back not supported");
+    case STATUS_ROUND_TRIP_MISMATCH:
+        return QStringLiteral("round trip changes bytes that are not fixups");
+    }
+    return QString();
+}
+/* formatResult - format one result as a report line
+*/
+QString GRETranscodeCheck::formatResult(const Result &result)
+{
+    // only the platform codes are upper case hex, the file name is shown as it is
+    QString line = QString("%1 %2").arg(QFileInfo(result.fileName).fileName(), -24)
+            .arg(QString::number(result.platform, 16).toUpper().rightJustified(2, QLatin1Char('0')));
+    if(result.status == STATUS_LOAD_ERROR)
+        return line + QString(": ") + statusName(result.status);
+    line += QString(" to %1 version %2: %3").arg(QString::number(result.target, 16).toUpper().rightJustified(2, QLatin1Char('0')))
+            .arg(GREFirmware::formatVersion(result.version), 7).arg(statusName(result.status));
+    if((result.status == STATUS_OK) && (result.patchedBytes != 0))
+        line += QString(", %1 fixup bytes").arg(result.patchedBytes);
+    return line;
+}
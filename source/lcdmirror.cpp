@@ -0,0 +1,128 @@
+/* lcdmirror.cpp - A scanner LCD mirror widget class
+
+Copyright 2016 Eric A. Cottrell <eric.c.boston@gmail.com>
+
+This file is part of GREFwTool. Source code is available at https://github.com/LinuxSheeple-E/GREFwTool
+
+    GREFwTool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GREFwTool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with GREFwTool.  If not, see <http://www.gnu.org/licenses/>.
+	
+*/
+#include "include/lcdmirror.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QCloseEvent>
+#include <QFontDatabase>
+
+#include <cstring>
+
+/* Constructor
+*/
+LCDMirror::LCDMirror(QWidget *parent)
+    : QWidget(parent, Qt::Tool)
+{
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(14);
+    setFont(font);
+    cellWidth = fontMetrics().width(QLatin1Char('W')) + 2;
+    cellHeight = fontMetrics().height() + 4;
+    memset(frame.lcd, ' ', sizeof(frame.lcd));
+    memset(frame.icons, 0, sizeof(frame.icons));
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setWindowTitle(tr("LCD Mirror"));
+}
+/* sizeHint - room for all LCD rows and the icon row
+*/
+QSize LCDMirror::sizeHint() const
+{
+    return QSize(COLUMNS * cellWidth + 2 * MARGIN, (ROWS + 1) * cellHeight + 2 * MARGIN);
+}
+/* cellRect - return the rectangle of one LCD character
+*/
+QRect LCDMirror::cellRect(int index) const
+{
+    return QRect(MARGIN + (index % COLUMNS) * cellWidth, MARGIN + (index / COLUMNS) * cellHeight, cellWidth, cellHeight);
+}
+/* iconRect - return the rectangle of one icon indicator, the icons are shown below the characters
+*/
+QRect LCDMirror::iconRect(int index) const
+{
+    int width = (COLUMNS * cellWidth) / ICON_COUNT;
+    return QRect(MARGIN + index * width + 1, MARGIN + ROWS * cellHeight + cellHeight / 4, width - 2, cellHeight / 2);
+}
+/* updateFrame - take the changed parts of a frame and repaint only those
+*/
+void LCDMirror::updateFrame(const GREParser::GetLCDVal &newFrame, const GRELCDMirror::Changes &changes)
+{
+    for(int i = 0; i < changes.rangeCount; i++)
+    {
+        int first = changes.ranges[i].first;
+        int last = changes.ranges[i].last;
+        memcpy(frame.lcd + first, newFrame.lcd + first, last - first + 1);
+        // one rectangle per row the range touches
+        for(int row = first / COLUMNS; row <= last / COLUMNS; row++)
+        {
+            int begin = qMax(first, row * COLUMNS);
+            int end = qMin(last, row * COLUMNS + COLUMNS - 1);
+            update(cellRect(begin).united(cellRect(end)));
+        }
+    }
+    if(changes.iconMask != 0)
+    {
+        memcpy(frame.icons, newFrame.icons, sizeof(frame.icons));
+        for(int i = 0; i < ICON_COUNT; i++)
+            if(changes.iconMask & (1u << i))
+                update(iconRect(i));
+    }
+}
+/* setFrameRate - show the achieved frame rate in the title
+*/
+void LCDMirror::setFrameRate(double fps)
+{
+    setWindowTitle(tr("LCD Mirror - %1 fps").arg(fps, 0, 'f', 1));
+}
+/* paintEvent - draw the characters and icons inside the damaged region
+*/
+void LCDMirror::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    const QRect damaged = event->rect();
+    painter.fillRect(damaged, QColor(0x9c, 0xb8, 0x8c));
+    painter.setPen(Qt::black);
+    for(int i = 0; i < GREParser::LCD_SIZE; i++)
+    {
+        QRect rect = cellRect(i);
+        if(!rect.intersects(damaged))
+            continue;
+        uchar c = frame.lcd[i];
+        painter.drawText(rect, Qt::AlignCenter, QString(QLatin1Char(((c >= ' ') && (c <= '~')) ? c : ' ')));
+    }
+    for(int i = 0; i < ICON_COUNT; i++)
+    {
+        QRect rect = iconRect(i);
+        if(!rect.intersects(damaged))
+            continue;
+        if(frame.icons[i / 8] & (1 << (i % 8)))
+            painter.fillRect(rect, Qt::black);
+        else
+            painter.drawRect(rect.adjusted(0, 0, -1, -1));
+    }
+}
+/* closeEvent - report the window closing so polling can stop
+*/
+void LCDMirror::closeEvent(QCloseEvent *event)
+{
+    emit closed();
+    QWidget::closeEvent(event);
+}
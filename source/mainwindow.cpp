@@ -24,8 +24,17 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 #include "include/settingsdialog.h"
 #include "include/webdownloader.h"
 #include "include/grefirmware.h"
+#include "include/grefirmwarecache.h"
+#include "include/grefirmwarecatalogue.h"
+#include "include/greringbuffer.h"
+#include "include/grecapture.h"
+#include "include/greccdump.h"
+#include "include/grelcdmirror.h"
+#include "include/lcdmirror.h"
+#include "include/gretrace.h"
 
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QProgressDialog>
 #include <QStandardPaths>
 #include <QtSerialPort/QSerialPort>
@@ -34,6 +43,7 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 #include <QString>
 #include <QStringList>
 #include <QFile>
+#include <QtConcurrent/QtConcurrentRun>
 
 /* Constructor
 */
@@ -41,6 +51,7 @@ MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     scannerMode(SCANNER_MODE_UNKNOWN),
+    updateFramed(false),
     nakCount(0)
 {
     ui->setupUi(this);
@@ -54,7 +65,17 @@ MainWindow::MainWindow(QWidget *parent) :
     progress = nullptr;
     downloader = new WebDownloader(this);
     firmware = new GREFirmware(this);
+    firmwareCache = new GREFirmwareCache(this);
     parser = new GREParser(this);
+    rxBuffer = new GRERingBuffer(RX_BUFFER_SIZE);
+    rxBytesAtConnect = 0;
+    rxAllocationsAtConnect = 0;
+    capture = new GRECapture(this);
+    replay = new GRECaptureReplay(parser, this);
+    ccDump = new GRECCDump(this);
+    lcdMirror = new GRELCDMirror(parser, this);
+    lcdWindow = new LCDMirror(this);
+    trace = new GRETrace(TRACE_BUFFER_SIZE);
 
 	// Connect the UI actions to the class slots
     connect(ui->actionConnect, SIGNAL(triggered()), this, SLOT(openSerialPort()));
@@ -68,6 +89,15 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionClearPassword, SIGNAL(triggered(bool)), parser, SLOT(clearPassword()));
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(about()));
     connect(ui->actionAboutQt, SIGNAL(triggered()), qApp, SLOT(aboutQt()));
+    connect(ui->actionCaptureProtocol, SIGNAL(toggled(bool)), this, SLOT(toggleCapture(bool)));
+    connect(ui->actionReplayCapture, SIGNAL(triggered()), this, SLOT(replayCapture()));
+    connect(ui->actionShowLatency, SIGNAL(triggered()), this, SLOT(showLatency()));
+    connect(ui->actionShowLinkStats, SIGNAL(triggered()), this, SLOT(showLinkStats()));
+    connect(ui->actionShowTrace, SIGNAL(triggered()), this, SLOT(showTrace()));
+    connect(ui->actionCheckTranscodes, SIGNAL(triggered()), this, SLOT(checkTranscodes()));
+    connect(&transcodeCheck, SIGNAL(finished()), this, SLOT(processTranscodeCheck()));
+    connect(ui->actionStreamCCDump, SIGNAL(toggled(bool)), this, SLOT(toggleCCDumpStream(bool)));
+    connect(ui->actionLCDMirror, SIGNAL(toggled(bool)), this, SLOT(toggleLCDMirror(bool)));
 
 	// Setup the actions
     ui->actionConnect->setEnabled(true);
@@ -77,10 +107,22 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->actionUpdateFirmware->setEnabled(false);
     ui->actionSetTime->setEnabled(false);
     ui->actionClearPassword->setEnabled(false);
+    ui->actionCaptureProtocol->setEnabled(true);
+    ui->actionReplayCapture->setEnabled(true);
+    ui->actionShowLatency->setEnabled(true);
+    ui->actionShowLinkStats->setEnabled(true);
+    ui->actionShowTrace->setEnabled(true);
+    ui->actionCheckTranscodes->setEnabled(true);
+    ui->actionStreamCCDump->setEnabled(false);
+    ui->actionLCDMirror->setEnabled(false);
 
 	// Setup the scanner file directory and scanner type configuration
     scannerFileDirectory = QStandardPaths::locate(QStandardPaths::AppDataLocation, QString(), QStandardPaths::LocateDirectory);
     scannerTypeConfig();
+    catalogue = new GREFirmwareCatalogue(scannerFileDirectory.isEmpty() ? QString() : scannerFileDirectory + QString::fromUtf8("firmware.idx"), this);
+    catalogue->loadIndex();
+    scanFirmware();
+    traceFilter = settings->getCurrentSettings().protocolTrace;
 
 	// Wire the class signals to the class slots
     connect(settings, SIGNAL(applySettings()), this, SLOT(handleApplySettings()));
@@ -89,19 +131,36 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(downloader, SIGNAL(downloadError()), this, SLOT(processDownloadError()));
 
     connect(serial, SIGNAL(error(QSerialPort::SerialPortError)), this, SLOT(handleSerialError(QSerialPort::SerialPortError)));
-    connect(serial, SIGNAL(readyRead()), this, SLOT(readData()));
 
-    connect(parser, SIGNAL(sendData(QByteArray)), this, SLOT(writeData(QByteArray)));
-    connect(parser, SIGNAL(updateEOT(void)), this, SLOT(processEOT(void)));
-    connect(parser, SIGNAL(updateEnq(void)), this, SLOT(processEnq(void)));
-    connect(parser, SIGNAL(updateAck(void)), this, SLOT(processAck(void)));
-    connect(parser, SIGNAL(updateDLE(void)), this, SLOT(processDLE(void)));
-    connect(parser, SIGNAL(updateNak(void)), this, SLOT(processNak(void)));
-    connect(parser, SIGNAL(updateCan(void)), this, SLOT(processCan(void)));
-    connect(parser, SIGNAL(updateCpuUpdateMode(void)), this, SLOT(processCpuUpdateMode(void)));
-    connect(parser, SIGNAL(updatePowerStatus(bool)), this, SLOT(processPowerStatus(bool)));
-    connect(parser, SIGNAL(updateVersion(GREParser::VersionVal)), this, SLOT(processVersion(GREParser::VersionVal)));
-    connect(parser, SIGNAL(updateCCDump(QString)), this, SLOT(processCCDump(QString)));
+	// The receive and firmware update path is connected by member function pointer, checked by the
+	// compiler and dispatched directly. Packets are passed as views and never copied on the way.
+    connect(serial, &QSerialPort::readyRead, this, &MainWindow::readData, Qt::DirectConnection);
+
+    connect(parser, &GREParser::sendData, this, &MainWindow::writeData, Qt::DirectConnection);
+    connect(parser, &GREParser::updateEOT, this, &MainWindow::processEOT, Qt::DirectConnection);
+    connect(parser, &GREParser::updateEnq, this, &MainWindow::processEnq, Qt::DirectConnection);
+    connect(parser, &GREParser::updateAck, this, &MainWindow::processAck, Qt::DirectConnection);
+    connect(parser, &GREParser::updateDLE, this, &MainWindow::processDLE, Qt::DirectConnection);
+    connect(parser, &GREParser::updateNak, this, &MainWindow::processNak, Qt::DirectConnection);
+    connect(parser, &GREParser::updateCan, this, &MainWindow::processCan, Qt::DirectConnection);
+    connect(parser, &GREParser::updateCpuUpdateMode, this, &MainWindow::processCpuUpdateMode, Qt::DirectConnection);
+    connect(parser, &GREParser::updatePowerStatus, this, &MainWindow::processPowerStatus, Qt::DirectConnection);
+    connect(parser, &GREParser::updateVersion, this, &MainWindow::processVersion, Qt::DirectConnection);
+    connect(parser, &GREParser::requestTimeout, this, &MainWindow::processRequestTimeout, Qt::DirectConnection);
+    connect(parser, &GREParser::updateReady, this, &MainWindow::processReady, Qt::DirectConnection);
+    connect(parser, &GREParser::updateFrame, this, &MainWindow::processFrame, Qt::DirectConnection);
+    connect(parser, &GREParser::updateFrameError, this, &MainWindow::processFrameError, Qt::DirectConnection);
+    connect(parser, &GREParser::updateCCDump, ccDump, &GRECCDump::processLine, Qt::DirectConnection);
+    connect(ccDump, SIGNAL(sample(QString,quint64)), this, SLOT(processCCDump(QString,quint64)));
+    connect(ccDump, SIGNAL(streamFailed()), this, SLOT(processCCDumpFailed()));
+
+    connect(lcdMirror, SIGNAL(frameChanged(GREParser::GetLCDVal,GRELCDMirror::Changes)), lcdWindow, SLOT(updateFrame(GREParser::GetLCDVal,GRELCDMirror::Changes)));
+    connect(lcdMirror, SIGNAL(frameRate(double)), this, SLOT(processLCDRate(double)));
+    connect(lcdWindow, SIGNAL(closed()), this, SLOT(processLCDMirrorClosed()));
+
+    connect(replay, SIGNAL(replayTx(QByteArray)), this, SLOT(processReplayTx(QByteArray)));
+    connect(replay, SIGNAL(replayRx(QByteArray)), this, SLOT(processReplayRx(QByteArray)));
+    connect(replay, SIGNAL(finished()), this, SLOT(processReplayFinished()));
 
 	// Setup the download timeout timer
     dlTimer = new QTimer(this);
@@ -119,6 +178,10 @@ MainWindow::MainWindow(QWidget *parent) :
 */
 MainWindow::~MainWindow()
 {
+    prefetch.waitForFinished();
+    transcodeCheck.waitForFinished();
+    delete trace;
+    delete rxBuffer;
     delete settings;
     delete ui;
 }
@@ -139,6 +202,9 @@ void MainWindow::openSerialPort()
     serial->setStopBits(p.stopBits);
     serial->setFlowControl(p.flowControl);
     if (serial->open(QIODevice::ReadWrite)) {
+        rxBuffer->clear();
+        rxBytesAtConnect = rxBuffer->getTotalBytes();
+        rxAllocationsAtConnect = rxBuffer->getAllocations();
         parser->initialize();
         ui->actionConnect->setEnabled(false);
         ui->actionDisconnect->setEnabled(true);
@@ -146,7 +212,11 @@ void MainWindow::openSerialPort()
         ui->actionUpdateFirmware->setEnabled(false);
         ui->actionSetTime->setEnabled(true);
         ui->actionClearPassword->setEnabled(true);
+        ui->actionReplayCapture->setEnabled(false);
+        ui->actionStreamCCDump->setEnabled(true);
+        ui->actionLCDMirror->setEnabled(true);
         display->putMessage(tr("Connected to %1 " ).arg(p.serialPortName));
+        prefetchFirmware();
     } else {
         display->putError(tr("Open Serial Port Error: %1").arg(serial->errorString()));
         QMessageBox::critical(this, tr("Error"), serial->errorString());
@@ -164,11 +234,23 @@ void MainWindow::closeSerialPort()
     ui->actionUpdateFirmware->setEnabled(false);
     ui->actionSetTime->setEnabled(false);
     ui->actionClearPassword->setEnabled(false);
+    ui->actionReplayCapture->setEnabled(true);
+    ui->actionStreamCCDump->setChecked(false);
+    ui->actionStreamCCDump->setEnabled(false);
+    ui->actionLCDMirror->setChecked(false);
+    ui->actionLCDMirror->setEnabled(false);
     if (serial->isOpen())
     {
         serial->close();
     }
     display->putMessage(tr("Disconnected from %1 " ).arg(p.serialPortName));
+    saveLatency();
+    if(parser->getLinkStats().bytesDiscarded != 0)
+        showLinkStats();
+    // report the receive buffer usage of this session, the ring buffer should not allocate while connected
+    display->putMessage(tr("Received %1 bytes with %2 receive buffer allocations ")
+                        .arg(rxBuffer->getTotalBytes() - rxBytesAtConnect)
+                        .arg(rxBuffer->getAllocations() - rxAllocationsAtConnect));
 }
 /* about - A simple about box
 */
@@ -181,26 +263,40 @@ void MainWindow::about()
 */
 void MainWindow::writeData(const QByteArray &data)
 {
-    SettingsDialog::Settings p = settings->getCurrentSettings();
    if (serial->isOpen())
    {
         serial->write(data);
-        if(p.protocolDebugEnabled)
-            displayProtocol(data, true);
+        if(capture->isActive())
+            capture->record(GRECaptureFormat::DIRECTION_TX, data.constData(), data.size());
+        if(traceFilter != 0)
+            traceTx(data);
    }
 }
 /* readData - read data from the scanner
+		The serial port reads straight into the receive ring buffer and the parser consumes it in place
 */
 void MainWindow::readData()
 {
-    SettingsDialog::Settings p = settings->getCurrentSettings();
-    QByteArray data;
+    char *span;
+    int length;
+    qint64 count;
     if (serial->isOpen())
     {
-        data = serial->readAll();
-        if(p.protocolDebugEnabled)
-            displayProtocol(data, false);
-        parser->receiveData(data);
+        while(serial->bytesAvailable() > 0)
+        {
+            span = rxBuffer->writeSpan(length);
+            if(length <= 0)
+                break;
+            count = serial->read(span, length);
+            if(count <= 0)
+                break;
+            rxBuffer->commit(static_cast<int>(count));
+            if(capture->isActive())
+                capture->record(GRECaptureFormat::DIRECTION_RX, span, static_cast<int>(count));
+            if(traceFilter & GRETrace::FILTER_BYTES)
+                trace->record(GRETrace::TRACE_RX_BYTES, span, static_cast<int>(count));
+            parser->receiveData(*rxBuffer);
+        }
     }
 }
 /* dlTimeout - process the download timeout timer
@@ -224,40 +320,61 @@ void MainWindow::commsTimeout()
     progress->cancel();
     processCan(); // cancel and close serial port
 }
-/* displayProtocol - display bytes sent and received from scanner
-		This is used for debugging purposes
+/* processFrame - trace a complete frame received from scanner
+*/
+void MainWindow::processFrame(const QByteArray &frame)
+{
+    // with the full bytes level the frame is already traced as received bytes
+    if((traceFilter & GRETrace::FILTER_FRAMES) && !(traceFilter & GRETrace::FILTER_BYTES))
+        trace->record(GRETrace::TRACE_RX_FRAME, frame.constData(), frame.size());
+}
+/* processFrameError - trace a damaged frame received from scanner
 */
-void MainWindow::displayProtocol(const QByteArray &data, bool txFlag)
+void MainWindow::processFrameError(const QByteArray &frame)
 {
-    QString displayBytes;
-    QString displayAscii;
-    QString value;
-    for(QByteArray::const_iterator it = data.cbegin(); it != data.cend(); it++)
+    if(traceFilter & GRETrace::FILTER_ERRORS)
+        trace->record(GRETrace::TRACE_DAMAGED_FRAME, frame.constData(), frame.size());
+}
+/* showTrace - format the recorded protocol trace and display it
+		This is used for debugging purposes. Nothing is formatted until the trace is shown.
+*/
+void MainWindow::showTrace()
+{
+    int count = trace->getEntryCount();
+    int first = qMax(0, count - TRACE_SHOW_ENTRIES);
+    if(count == 0)
     {
-        unsigned char c = *it;
-        value = QString("%1 ").arg(c, 2, 16, QLatin1Char('0'));
-        displayBytes.append(value);
-        if((c >= ' ' && c <= '~') )
-        {
-            displayAscii.append(c);
-        }
-        else
+        display->putMessage(tr("The protocol trace is empty, select a Protocol Trace level in Settings. "));
+        return;
+    }
+    for(int i = first; i < count; i++)
+    {
+        switch(trace->getEntryKind(i))
         {
-            value = QString("<%1>").arg(c, 2, 16, QLatin1Char('0'));
-            displayAscii.append(value);
+        case GRETrace::TRACE_TX_BYTES:
+        case GRETrace::TRACE_TX_FRAME:
+        case GRETrace::TRACE_TX_CONTROL:
+            display->putTxBytes(trace->formatEntry(i));
+            break;
+        case GRETrace::TRACE_DAMAGED_FRAME:
+        case GRETrace::TRACE_TIMEOUT:
+            display->putError(trace->formatEntry(i));
+            break;
+        default:
+            display->putRxBytes(trace->formatEntry(i));
+            break;
         }
-
     }
-    if(txFlag)
-        display->putTxBytes(tr("Tx[Hex: %1 Ascii: %2] ").arg(displayBytes).arg(displayAscii));
-    else
-        display->putRxBytes(tr("Rx[Hex: %1 Ascii: %2] ").arg(displayBytes).arg(displayAscii));
-
+    // the trace is kept so it can be shown again, say what is not on the screen
+    if((first > 0) || (trace->getRecordedCount() > static_cast<quint64>(count)))
+        display->putMessage(tr("Protocol trace: last %1 of %2 entries shown, %3 older entries not kept. ")
+                            .arg(count - first).arg(count).arg(trace->getRecordedCount() - count));
 }
 /* processEOT - process the CPU Update complete character from scanner
 */
 void MainWindow::processEOT(void )
 {
+    traceControl(GREProtocol::EOT);
     commsTimer->stop();
     QString message("CPU Update Complete. Reconnect after scanner reboots. ");
     closeSerialPort();  // Prevent error on Scanner Report
@@ -272,14 +389,15 @@ void MainWindow::processEOT(void )
 */
 void MainWindow::processEnq(void )
 {
+    traceControl(GREProtocol::ENQ);
     QString message("CPU is updating.");
     commsTimer->stop();
     if(scannerMode == SCANNER_MODE_CPU_UPDATE)
     {
-        updatePacket = firmware->getNextPacket();
+        updatePacket = updateFramed ? firmware->getNextFrame() : firmware->getNextPacket();
         if(!updatePacket.isEmpty())
         {
-            parser->sendPacket(updatePacket);
+            sendUpdatePacket();
             progress->setValue(firmware->getOffset());
         }
         commsTimer->start();
@@ -292,13 +410,14 @@ void MainWindow::processEnq(void )
 */
 void MainWindow::processAck(void )
 {
+    traceControl(GREProtocol::ACK);
     commsTimer->stop();
     if(scannerMode == SCANNER_MODE_UPDATE_IN_PROGRESS)
     {
-        updatePacket = firmware->getNextPacket();
+        updatePacket = updateFramed ? firmware->getNextFrame() : firmware->getNextPacket();
         if(!updatePacket.isEmpty())
         {
-            parser->sendPacket(updatePacket);
+            sendUpdatePacket();
             progress->setValue(firmware->getOffset());
         }
         commsTimer->start();
@@ -309,6 +428,7 @@ void MainWindow::processAck(void )
 */
 void MainWindow::processDLE(void )
 {
+    traceControl(GREProtocol::DLE);
     QString message("CPU Update Wait. ");
     commsTimer->start();
     nakCount = 0;
@@ -318,6 +438,7 @@ void MainWindow::processDLE(void )
 */
 void MainWindow::processNak(void )
 {
+    traceControl(GREProtocol::NAK);
     QString message("CPU Update Rejected. ");
     commsTimer->stop();
     if((scannerMode == SCANNER_MODE_UPDATE_IN_PROGRESS) && !updatePacket.isEmpty())
@@ -330,7 +451,7 @@ void MainWindow::processNak(void )
             QMessageBox::critical(this, tr("Error"), message);
             return;
         }
-        parser->sendPacket(updatePacket);
+        sendUpdatePacket();
         commsTimer->start();
     }
 }
@@ -338,6 +459,7 @@ void MainWindow::processNak(void )
 */
 void MainWindow::processCan(void )
 {
+    traceControl(GREProtocol::CAN);
     QString message("CPU Update Error.");
     commsTimer->stop();
     updatePacket.clear();
@@ -351,7 +473,12 @@ void MainWindow::processCan(void )
 */
 void MainWindow::processCpuUpdateMode(void )
 {
+    traceControl('C');
     QString message("Scanner is in CPU Update Mode. ");
+    // the bootloader only knows the version command
+    ui->actionLCDMirror->setChecked(false);
+    ui->actionLCDMirror->setEnabled(false);
+    ui->actionStreamCCDump->setEnabled(false);
     display->putMessage(message);
     ui->actionUpdateFirmware->setEnabled(true);
     scannerMode = SCANNER_MODE_CPU_UPDATE;
@@ -369,16 +496,39 @@ void MainWindow::processPowerStatus(const bool &data )
 */
 void MainWindow::processVersion(const GREParser::VersionVal &data )
 {
-    QString message = QString("Version %1  %2  %3  %4  %5 ").arg(data.model).arg(data.ver1).arg(data.ver2).arg(data.ver3).arg(data.ver4);
+    QString message = QString("Version %1 ").arg(GREParser::formatVersion(data));
     display->putMessage(message);
 }
-/* processCCDump - Simple processing of CCDump response from scanner
+/* processCCDump - display the CCDump lines from scanner
+		GRECCDump passes on every line, or one line per interval while it streams them to file
+*/
+void MainWindow::processCCDump(const QString &line, quint64 lineCount)
+{
+    QString message = QString("CCDump: %1 [%2 lines] ").arg(line).arg(lineCount);
+    display->putMessage(message);
+}
+/* processCCDumpFailed - stop streaming CCDump when the file can no longer be written
+*/
+void MainWindow::processCCDumpFailed()
+{
+    display->putError(tr("Unable to write the CCDump file, streaming stopped. "));
+    ui->actionStreamCCDump->setChecked(false);
+}
+/* processReady - report the time from connect until the scanner mode was known
 */
-void MainWindow::processCCDump(const QString &data )
+void MainWindow::processReady(bool bootloader, qint64 msecs)
 {
-    QString message = QString("CCDump: %1 ").arg(data);
+    QString message = QString("Scanner ready in %1 ms, %2 mode. ").arg(msecs).arg((bootloader)?"CPU update":"application");
     display->putMessage(message);
 }
+/* processRequestTimeout - report a command the scanner did not answer in time
+*/
+void MainWindow::processRequestTimeout(char command)
+{
+    if(traceFilter & GRETrace::FILTER_ERRORS)
+        trace->record(GRETrace::TRACE_TIMEOUT, &command, 1);
+    display->putError(tr("No response to command '%1' ").arg(QLatin1Char(command)));
+}
 /* handleSerialError - process Serial Port errors
 */
 void MainWindow::handleSerialError(QSerialPort::SerialPortError error)
@@ -408,6 +558,7 @@ void MainWindow::handleSerialError(QSerialPort::SerialPortError error)
 */
 void MainWindow::handleApplySettings()
 {
+    traceFilter = settings->getCurrentSettings().protocolTrace;
     scannerTypeConfig();
 }
 /* scannerTypeConfig - configure remote directories and filenames based on firmware type
@@ -679,40 +830,93 @@ void MainWindow::processDownloadError()
 void MainWindow::processFirmwareUpdate()
 {
     SettingsDialog::Settings s = settings->getCurrentSettings();
-    if(firmware->openFile(scannerFileDirectory))
+    // Display dialog to get firmware binary file, the latest version for the scanner is selected
+    scanFirmware();
+    int latest = catalogue->findLatest(s.firmwareType);
+    QString start = (latest < 0) ? scannerFileDirectory : catalogue->getEntry(latest).path;
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Firmware Image"), start, tr("Firmware Files (*.BIN *.7z)"));
+    if(fileName.isEmpty())
+        return;
+    // The cache loads, transcodes and encodes each file once, this transfer only gets a cursor
+    GREFirmwareCache::Error error = GREFirmwareCache::ERROR_LOAD;
+    QString loadError;
+    QSharedPointer<const GREFirmware::Image> image = firmwareCache->acquire(fileName, s.firmwareType, s.scannerType, s.preEncodePackets, error, &loadError);
+    if(image.isNull() || !firmware->attach(image))
     {
-        if(firmware->getPlatform() == s.firmwareType)
+        QString message;
+        if(!image.isNull())     // the shared image could not be attached to this transfer
+            loadError = firmware->getErrorString();
+        switch(error)
         {
-            if((s.scannerType != s.firmwareType) && !firmware->transcode(s.scannerType))
-			{   // if transcode is needed and not supported then error
-                QString message("Transcode not supported for this scanner or version of firmware. ");
-				display->putError(message);
-				QMessageBox::critical(this, tr("Error"), message);
-				return;
-			}
-            ui->actionUpdateFirmware->setEnabled(false);
-            // Create progress dialog, if needed, without an abort button.
-            if(progress == nullptr)
-            {
-                progress = new QProgressDialog("Updating Firmware", QString(), 0, firmware->getImageSize(), this);
-            }
-            else // update image size of existing dialog
-            {
-                progress->setMaximum(firmware->getImageSize());
-            }
-			// send the header
-            updatePacket = firmware->getFirstPacket();
-            parser->sendPacket(updatePacket);
-            commsTimer->start();
+        case GREFirmwareCache::ERROR_PLATFORM:
+            message = "Wrong firmware file for scanner. ";
+            break;
+        case GREFirmwareCache::ERROR_TRANSCODE:
+            message = "Transcode not supported for this scanner or version of firmware. ";
+            break;
+        case GREFirmwareCache::ERROR_ENCODE:
+            message = "Unable to prepare the firmware update packets. ";
+            break;
+        default:
+            if(loadError.isEmpty())
+                message = "Unable to load firmware file. ";
+            else
+                message = QString("Unable to load firmware file, %1. ").arg(loadError);
+            break;
         }
-        else
+        display->putError(message);
+        QMessageBox::critical(this, tr("Error"), message);
+        return;
+    }
+    catalogue->setHash(fileName, firmwareCache->getFileHash(fileName));
+    catalogue->saveIndex();
+    // Check the image once more before the scanner erases its firmware
+    GREFirmware::Preflight check;
+    if(!firmware->preflight(check))
+    {
+        QString message;
+        switch(check.error)
         {
-            QString message("Wrong firmware file for scanner. ");
-            display->putError(message);
-            QMessageBox::critical(this, tr("Error"), message);
+        case GREFirmware::PREFLIGHT_TRANSCODE:
+            message = "Transcode not supported for this scanner. ";
+            break;
+        case GREFirmware::PREFLIGHT_VERSION:
+            message = "Firmware version not valid or not supported for this scanner. ";
+            break;
+        case GREFirmware::PREFLIGHT_PATCH_OFFSET:
+            message = "Firmware version fixup is outside the firmware image. ";
+            break;
+        case GREFirmware::PREFLIGHT_FRAMES:
+            message = "Firmware update packets do not match the firmware image. ";
+            break;
+        default:
+            message = "No firmware image loaded. ";
+            break;
         }
+        firmware->close();
+        display->putError(message);
+        QMessageBox::critical(this, tr("Error"), message);
+        return;
     }
-
+    display->putMessage(tr("Firmware version %1 for platform %2, fingerprint %3 ")
+                        .arg(GREFirmware::formatVersion(check.version))
+                        .arg(QString::number(check.platform, 16).toUpper())
+                        .arg(QString::number(check.fingerprint, 16).toUpper().rightJustified(16, QLatin1Char('0'))));
+    ui->actionUpdateFirmware->setEnabled(false);
+    // Create progress dialog, if needed, without an abort button.
+    if(progress == nullptr)
+    {
+        progress = new QProgressDialog("Updating Firmware", QString(), 0, firmware->getImageSize(), this);
+    }
+    else // update image size of existing dialog
+    {
+        progress->setMaximum(firmware->getImageSize());
+    }
+    // send the header, from the pre-encoded packet table if enabled
+    updateFramed = s.preEncodePackets && firmware->hasFrames();
+    updatePacket = updateFramed ? firmware->getFirstFrame() : firmware->getFirstPacket();
+    sendUpdatePacket();
+    commsTimer->start();
 }
 /* setTime - set the date and time on scanner using current computer date and time
 */
@@ -722,3 +926,264 @@ void MainWindow::setTime()
     parser->setDateTime(QDateTime::currentDateTime());
     display->putMessage(message);
 }
+/* toggleCapture - start or stop recording the protocol to a capture file
+*/
+void MainWindow::toggleCapture(bool enable)
+{
+    if(enable)
+    {
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save Protocol Capture"), scannerFileDirectory, tr("Protocol Capture Files (*.grecap)"));
+        if(fileName.isEmpty() || !capture->start(fileName))
+        {
+            if(!fileName.isEmpty())
+                display->putError(tr("Unable to create capture file %1 ").arg(fileName));
+            ui->actionCaptureProtocol->setChecked(false);
+            return;
+        }
+        display->putMessage(tr("Capturing protocol to %1 ").arg(fileName));
+    }
+    else if(capture->isActive())
+    {
+        capture->stop();
+        display->putMessage(tr("Protocol capture stopped, %1 records. ").arg(capture->getRecordCount()));
+    }
+}
+/* replayCapture - replay a capture file through the parser while disconnected
+*/
+void MainWindow::replayCapture()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open Protocol Capture"), scannerFileDirectory, tr("Protocol Capture Files (*.grecap)"));
+    if(fileName.isEmpty())
+        return;
+    if(!replay->open(fileName))
+    {
+        QString message("Not a protocol capture file. ");
+        display->putError(message);
+        QMessageBox::critical(this, tr("Error"), message);
+        return;
+    }
+    bool recordedSpeed = (QMessageBox::question(this, tr("Replay Capture"), tr("Replay at the recorded speed?")) == QMessageBox::Yes);
+    display->putMessage(tr("Replaying %1 ").arg(fileName));
+    ui->actionConnect->setEnabled(false);
+    ui->actionReplayCapture->setEnabled(false);
+    scannerMode = SCANNER_MODE_UNKNOWN;
+    parser->initializeReplay();
+    replay->start(recordedSpeed);
+}
+/* processReplayTx - display data sent in a replayed capture
+*/
+void MainWindow::processReplayTx(const QByteArray &data)
+{
+    if(traceFilter != 0)
+        traceTx(data);
+}
+/* processReplayRx - display data received in a replayed capture
+*/
+void MainWindow::processReplayRx(const QByteArray &data)
+{
+    if(traceFilter & GRETrace::FILTER_BYTES)
+        trace->record(GRETrace::TRACE_RX_BYTES, data.constData(), data.size());
+}
+/* processReplayFinished - process the end of a replay
+*/
+void MainWindow::processReplayFinished()
+{
+    QString message("Replay complete. ");
+    display->putMessage(message);
+    ui->actionConnect->setEnabled(true);
+    ui->actionReplayCapture->setEnabled(true);
+}
+/* showLatency - display the response latency of each command seen this session
+*/
+void MainWindow::showLatency()
+{
+    bool empty = true;
+    for(int i = 0; i < GREParser::LATENCY_COUNT; i++)
+    {
+        const GRELatencyHistogram &histogram = parser->getLatency(i);
+        if(histogram.getCount() == 0)
+            continue;
+        display->putMessage(tr("%1: %2 ").arg(GREParser::latencyName(i)).arg(histogram.summary()));
+        empty = false;
+    }
+    if(empty)
+        display->putMessage(tr("No latency recorded. "));
+}
+/* showLinkStats - display the receive error counts of the serial link
+*/
+void MainWindow::showLinkStats()
+{
+    const GREParser::LinkStats &stats = parser->getLinkStats();
+    display->putMessage(tr("Link: %1 checksum errors, %2 length errors, %3 resyncs, %4 bytes discarded ")
+                        .arg(stats.checksumErrors).arg(stats.lengthErrors)
+                        .arg(stats.resyncEvents).arg(stats.bytesDiscarded));
+    display->putMessage(tr("Requests: %1 unsolicited responses, %2 requests dropped for the scanner mode ")
+                        .arg(parser->getUnsolicitedCount()).arg(parser->getDroppedCount()));
+}
+/* checkTranscodes - check every catalogued firmware against every supported transcode
+		The check runs on the thread pool, processTranscodeCheck reports the results
+*/
+void MainWindow::checkTranscodes()
+{
+    QStringList fileNames;
+    if(transcodeCheck.isRunning())
+        return;
+    scanFirmware();
+    for(int i = 0; i < catalogue->getEntryCount(); i++)
+    {
+        if(catalogue->getEntry(i).valid)
+            fileNames << catalogue->getEntry(i).path;
+    }
+    if(fileNames.isEmpty())
+    {
+        display->putError(tr("No firmware files to check"));
+        return;
+    }
+    display->putMessage(tr("Checking transcodes of %1 firmware files").arg(fileNames.size()));
+    ui->actionCheckTranscodes->setEnabled(false);
+    transcodeCheck.setFuture(QtConcurrent::run(GRETranscodeCheck::run, fileNames));
+}
+/* processTranscodeCheck - report the results of the transcode check
+*/
+void MainWindow::processTranscodeCheck()
+{
+    QVector<GRETranscodeCheck::Result> results = transcodeCheck.result();
+    int failures = 0;
+    ui->actionCheckTranscodes->setEnabled(true);
+    foreach(const GRETranscodeCheck::Result &result, results)
+    {
+        if(GRETranscodeCheck::isFailure(result.status))
+        {
+            display->putError(GRETranscodeCheck::formatResult(result));
+            failures++;
+        }
+        else
+            display->putMessage(GRETranscodeCheck::formatResult(result));
+    }
+    display->putMessage(tr("Transcode check: %1 checks, %2 failed").arg(results.size()).arg(failures));
+}
+/* saveLatency - append the latency of the session to the latency log
+*/
+void MainWindow::saveLatency()
+{
+    QFile file(scannerFileDirectory + QString::fromUtf8("latency.log"));
+    QTextStream out(&file);
+    bool empty = true;
+    for(int i = 0; i < GREParser::LATENCY_COUNT; i++)
+        if(parser->getLatency(i).getCount() != 0)
+            empty = false;
+    if(empty || !file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return;
+    out << QDateTime::currentDateTime().toString(Qt::ISODate) << " " << settings->getCurrentSettings().serialPortName << "\n";
+    for(int i = 0; i < GREParser::LATENCY_COUNT; i++)
+    {
+        const GRELatencyHistogram &histogram = parser->getLatency(i);
+        if(histogram.getCount() != 0)
+            out << "    " << GREParser::latencyName(i) << ": " << histogram.summary() << "\n";
+    }
+    file.close();
+}
+/* toggleCCDumpStream - enable the scanner CCDump and stream the lines to a file, or stop doing so
+*/
+void MainWindow::toggleCCDumpStream(bool enable)
+{
+    if(enable)
+    {
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save CCDump"), scannerFileDirectory, tr("Tab Separated Files (*.tsv)"));
+        if(fileName.isEmpty() || !ccDump->start(fileName))
+        {
+            if(!fileName.isEmpty())
+                display->putError(tr("Unable to create CCDump file %1 ").arg(fileName));
+            ui->actionStreamCCDump->setChecked(false);
+            return;
+        }
+        parser->setCCDump(true);
+        display->putMessage(tr("Streaming CCDump to %1 ").arg(fileName));
+    }
+    else if(ccDump->isActive())
+    {
+        if(serial->isOpen())
+            parser->setCCDump(false);
+        ccDump->stop();
+        display->putMessage(tr("CCDump stream stopped, %1 lines, %2 bad lines, %3 bytes dropped. ")
+                            .arg(ccDump->getLineCount()).arg(ccDump->getBadLineCount()).arg(ccDump->getBytesDropped()));
+    }
+}
+/* toggleLCDMirror - show the LCD mirror and start polling the LCD, or stop doing so
+*/
+void MainWindow::toggleLCDMirror(bool enable)
+{
+    if(enable)
+    {
+        lcdWindow->show();
+        lcdMirror->start();
+    }
+    else
+    {
+        lcdMirror->stop();
+        lcdWindow->hide();
+        ui->statusBar->clearMessage();
+    }
+}
+/* processLCDRate - show the LCD mirror frame rate
+*/
+void MainWindow::processLCDRate(double fps)
+{
+    lcdWindow->setFrameRate(fps);
+    ui->statusBar->showMessage(tr("LCD mirror %1 fps").arg(fps, 0, 'f', 1));
+}
+/* processLCDMirrorClosed - stop polling when the LCD mirror window is closed
+*/
+void MainWindow::processLCDMirrorClosed()
+{
+    ui->actionLCDMirror->setChecked(false);
+}
+/* traceTx - trace data sent to scanner
+		Single bytes are the ACK and NAK replies, everything else is a framed command or packet
+*/
+void MainWindow::traceTx(const QByteArray &data)
+{
+    if(traceFilter & GRETrace::FILTER_BYTES)
+        trace->record(GRETrace::TRACE_TX_BYTES, data.constData(), data.size());
+    else if((data.size() == 1) && (traceFilter & GRETrace::FILTER_CONTROL))
+        trace->record(GRETrace::TRACE_TX_CONTROL, data.constData(), 1);
+    else if((data.size() > 1) && (traceFilter & GRETrace::FILTER_FRAMES))
+        trace->record(GRETrace::TRACE_TX_FRAME, data.constData(), data.size());
+}
+/* sendUpdatePacket - send the current firmware update packet
+*/
+void MainWindow::sendUpdatePacket()
+{
+    if(updateFramed)
+        parser->sendFrame(updatePacket);
+    else
+        parser->sendPacket(updatePacket);
+}
+/* scanFirmware - update the firmware catalogue from the scanner file directory and the bundled firmware
+		Only new or changed files are read, so this is cheap enough to do before every update
+*/
+void MainWindow::scanFirmware()
+{
+    QStringList directories;
+    directories << scannerFileDirectory << QCoreApplication::applicationDirPath() + QString::fromUtf8("/firmware");
+    if(catalogue->scan(directories))
+        catalogue->saveIndex();
+}
+/* prefetchFirmware - prepare the latest firmware for the scanner in the background
+		A 7z archive is decoded, transcoded and encoded into the image cache while the scanner
+		is detected, so a firmware update started afterwards finds it ready. An update started
+		before it is done waits for it in the cache.
+*/
+void MainWindow::prefetchFirmware()
+{
+    SettingsDialog::Settings s = settings->getCurrentSettings();
+    int latest = catalogue->findLatest(s.firmwareType);
+    if((latest < 0) || prefetch.isRunning())
+        return;
+    QString fileName = catalogue->getEntry(latest).path;
+    GREFirmwareCache *cache = firmwareCache;
+    prefetch = QtConcurrent::run([cache, fileName, s]() {
+        GREFirmwareCache::Error error;
+        cache->acquire(fileName, s.firmwareType, s.scannerType, s.preEncodePackets, error);
+    });
+}
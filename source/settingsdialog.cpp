@@ -20,6 +20,7 @@ This file is part of GREFwTool. Source code is available at https://github.com/L
 */
 #include "include/settingsdialog.h"
 #include "ui_settingsdialog.h"
+#include "include/gretrace.h"
 
 #include <QSettings>
 #include <QtSerialPort/QSerialPortInfo>
@@ -32,6 +33,8 @@ static const char settingsString[] = "Settings";
 static const char scannerIndexString[] = "ScannerIndex";
 static const char firmwareIndexString[] = "FirmwareIndex";
 static const char portIndexString[] = "PortIndex";
+static const char traceIndexString[] = "TraceIndex";
+static const char preEncodeString[] = "PreEncodePackets";
 
 /* Constructor
 */
@@ -86,6 +89,8 @@ void SettingsDialog::apply()
     if(idx < 0)
         idx = 0;
     config.setValue(portIndexString, idx);
+    config.setValue(traceIndexString, ui->protocolTraceListBox->currentIndex());
+    config.setValue(preEncodeString, ui->preEncodeCheckBox->isChecked());
     config.endGroup();
     hide();
     emit applySettings();
@@ -161,6 +166,13 @@ void SettingsDialog::fillScannerParameters()
     ui->scannerTypeListBox->setCurrentIndex(config.value(scannerIndexString, 0).toInt());
     fillFirmwareBox(ui->scannerTypeListBox->currentIndex());
     ui->firmwareListBox->setCurrentIndex(config.value(firmwareIndexString, 0).toInt());
+    ui->protocolTraceListBox->addItem(tr("Off"), 0);
+    ui->protocolTraceListBox->addItem(tr("Errors only"), GRETrace::FILTER_ERRORS);
+    ui->protocolTraceListBox->addItem(tr("Control bytes only"), GRETrace::FILTER_CONTROL);
+    ui->protocolTraceListBox->addItem(tr("Frames only"), GRETrace::FILTER_FRAMES);
+    ui->protocolTraceListBox->addItem(tr("Full bytes"), GRETrace::FILTER_ERRORS | GRETrace::FILTER_CONTROL | GRETrace::FILTER_FRAMES | GRETrace::FILTER_BYTES);
+    ui->protocolTraceListBox->setCurrentIndex(config.value(traceIndexString, 0).toInt());
+    ui->preEncodeCheckBox->setChecked(config.value(preEncodeString, true).toBool());
     config.endGroup();
 
 }
@@ -207,5 +219,6 @@ void SettingsDialog::updateSettings()
     currentSettings.flowControl = QSerialPort::NoFlowControl;
     currentSettings.stringFlowControl = tr("None");
 
-    currentSettings.protocolDebugEnabled = ui->protocolDebugCheckBox->isChecked();
+    currentSettings.protocolTrace = ui->protocolTraceListBox->itemData(ui->protocolTraceListBox->currentIndex()).toInt();
+    currentSettings.preEncodePackets = ui->preEncodeCheckBox->isChecked();
 }